@@ -3,8 +3,29 @@
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <errno.h>
+#include <stdint.h>
 #include "iso646.h"
 
+// flags shared with other threads and signal handlers
+#if defined(__STDC_NO_ATOMICS__) or (defined(_MSC_VER) and not defined(__clang__))
+	typedef volatile long forth_atomic_int; // msvc volatile access is acquire/release
+	#define forth_atomic_load(pointer) (*(pointer))
+	#define forth_atomic_store(pointer, value) (*(pointer) = (value))
+	#if defined(_MSC_VER) and not defined(__clang__)
+		#include <intrin.h>
+		#define forth_atomic_fetch_add(pointer, value) _InterlockedExchangeAdd(pointer, value)
+	#else
+		#define forth_atomic_fetch_add(pointer, value) __sync_fetch_and_add(pointer, value)
+	#endif
+#else
+	#include <stdatomic.h>
+	typedef atomic_int forth_atomic_int;
+	#define forth_atomic_load(pointer) atomic_load_explicit(pointer, memory_order_acquire)
+	#define forth_atomic_store(pointer, value) atomic_store_explicit(pointer, value, memory_order_release)
+	#define forth_atomic_fetch_add(pointer, value) atomic_fetch_add_explicit(pointer, value, memory_order_relaxed)
+#endif
+
 #ifdef FORTH_TEST_COMPONENTS
 	#define COMPONENT_PRIVATE
 #else
@@ -22,7 +43,7 @@
 
 #define array_size(x) sizeof(x)/sizeof(x[0])
 
-#define FOREACH_TOKENS(TOKENS) \
+#define FOREACH_CORE_TOKENS(TOKENS) \
 	TOKENS(tt_dup, "dup") \
 	TOKENS(tt_drop, "drop") \
 	TOKENS(tt_swap, "swap") \
@@ -54,6 +75,7 @@
 	TOKENS(tt_loop, "loop") \
 	TOKENS(tt_begin, "begin") \
 	TOKENS(tt_until, "until") \
+	TOKENS(tt_recurse, "recurse") \
 	\
 	TOKENS(tt_allot, "allot") \
 	TOKENS(tt_cells, "cells") \
@@ -64,21 +86,93 @@
 	TOKENS(tt_function, ":") \
 	TOKENS(tt_semicolon, ";") \
 
-#define GENERATE_ENUM(ENUM) ENUM,
+#if defined(FORTH_WORDS_BULK)
+#define FOREACH_BULK_TOKENS(TOKENS) \
+	TOKENS(tt_fill, "fill") \
+	TOKENS(tt_move, "move") \
+	TOKENS(tt_cmove, "cmove") \
+	TOKENS(tt_sum, "sum") \
+	TOKENS(tt_array_min, "array-min") \
+	TOKENS(tt_array_max, "array-max") \
+	TOKENS(tt_array_plus, "array+") \
+	TOKENS(tt_array_multip, "array*") \
+	TOKENS(tt_array_equal, "array=") \
+	TOKENS(tt_search, "search")
+#else
+#define FOREACH_BULK_TOKENS(TOKENS)
+#endif
+
+#if defined(FORTH_WORDS_HEAP)
+#define FOREACH_HEAP_TOKENS(TOKENS) \
+	TOKENS(tt_allocate, "allocate") \
+	TOKENS(tt_free, "free") \
+	TOKENS(tt_resize, "resize")
+#else
+#define FOREACH_HEAP_TOKENS(TOKENS)
+#endif
+
+#if defined(FORTH_WORDS_MESSAGE)
+#define FOREACH_MESSAGE_TOKENS(TOKENS) \
+	TOKENS(tt_receive, "receive") \
+	TOKENS(tt_message_ready, "?message")
+#else
+#define FOREACH_MESSAGE_TOKENS(TOKENS)
+#endif
+
+#if defined(FORTH_WORDS_FLOAT)
+#define FOREACH_FLOAT_TOKENS(TOKENS) \
+	TOKENS(tt_fplus, "f+") \
+	TOKENS(tt_fminus, "f-") \
+	TOKENS(tt_fmultip, "f*") \
+	TOKENS(tt_fdiv, "f/") \
+	TOKENS(tt_fless, "f<") \
+	TOKENS(tt_fequal, "f=") \
+	TOKENS(tt_fdup, "fdup") \
+	TOKENS(tt_fdrop, "fdrop") \
+	TOKENS(tt_fswap, "fswap") \
+	TOKENS(tt_fat, "f@") \
+	TOKENS(tt_fsetvalue, "f!") \
+	TOKENS(tt_fdot, "f.") \
+	TOKENS(tt_int_to_float, "s>f") \
+	TOKENS(tt_float_to_int, "f>s")
+#else
+#define FOREACH_FLOAT_TOKENS(TOKENS)
+#endif
+
+// word sets of build profile (FORTH_WORD_SETS), words of disabled sets are unknown names
+#define FOREACH_TOKENS(TOKENS) \
+	FOREACH_CORE_TOKENS(TOKENS) \
+	FOREACH_BULK_TOKENS(TOKENS) \
+	FOREACH_HEAP_TOKENS(TOKENS) \
+	FOREACH_MESSAGE_TOKENS(TOKENS) \
+	FOREACH_FLOAT_TOKENS(TOKENS) \
+
+#define GENERATE_ENUM(ENUM, STRING) ENUM,
+#define GENERATE_STRING(ENUM, STRING) STRING,
 
 enum token_type {
 	FOREACH_TOKENS(GENERATE_ENUM)
 	tt_ident,
+	tt_tail_call, // ident before ; jump without return position
+	tt_tail_recurse, // recurse before ;
+	tt_lazy_body, // source of word body, compiled on first call
+	tt_jump, // jump to compiled lazy body
 	tt_dotstring,
 	tt_value,
+	tt_float_value,
 
 	tt_none,
 };
 
+COMPONENT_PRIVATE const char* const token_names[] = { // source word of key word token
+	FOREACH_TOKENS(GENERATE_STRING)
+};
+
 struct token {
 	enum token_type type;
 	union {
-		int integer;
+		forth_cell integer;
+		forth_float real;
 		char* string;
 		char* name;
 	} data;
@@ -124,19 +218,34 @@ COMPONENT_PRIVATE struct token key_word_func_by(dotstring) (const char* word) {
 
 COMPONENT_PRIVATE struct token key_word_func_by(integer) (const char* word) {
 	char* enp_pos;
-	int value = strtol(word, &enp_pos, 10);
+	forth_cell value = (forth_cell)strtoll(word, &enp_pos, 10);
 	uintptr_t integer_lenght = enp_pos - word;
 	if (integer_lenght == strlen(word))
 		return (struct token) { .type = tt_value, .data.integer = value };
 	return (struct token) { .type = tt_none };
 }
 
+#if defined(FORTH_WORDS_FLOAT)
+COMPONENT_PRIVATE struct token key_word_func_by(real) (const char* word) { // 1.5 -2e3, dot or exponent and digit
+	if (strspn(word, "0123456789+-.eE") != strlen(word) or not strpbrk(word, ".eE") or not strpbrk(word, "0123456789"))
+		return (struct token) { .type = tt_none };
+	char* enp_pos;
+	double value = strtod(word, &enp_pos);
+	if (*enp_pos != '\0')
+		return (struct token) { .type = tt_none };
+	return (struct token) { .type = tt_float_value, .data.real = (forth_float)value };
+}
+#endif
+
 
-COMPONENT_PRIVATE struct token_type_pair key_words[] = {
+COMPONENT_PRIVATE const struct token_type_pair key_words[] = { // read only, tokenizer run from many threads
 	FOREACH_TOKENS(GENERATE_TOKEN_PAIRS)
 	
 	/// Must be last
 	{tt_value, key_word_func_by(integer)},
+#if defined(FORTH_WORDS_FLOAT)
+	{tt_float_value, key_word_func_by(real)},
+#endif
 	{tt_dotstring, key_word_func_by(dotstring)},
 	{tt_ident, key_word_func_by(identifier)},
 };
@@ -144,75 +253,233 @@ COMPONENT_PRIVATE struct token_type_pair key_words[] = {
 struct forth_byte_code {
 	struct token* stream;
 	int count;
+	int optimization_level; // used for appended scripts
+	struct cache_entry* cache_entry; // shared program of compile cache, immutable
+	forth_atomic_int running; // public run calls inside eval, append and reload refuse running program
 };
 
+COMPONENT_PRIVATE bool token_has_string(enum token_type type) {
+	return type == tt_dotstring or type == tt_ident or type == tt_tail_call or type == tt_lazy_body;
+}
+
+COMPONENT_PRIVATE void release_token(const struct token current_token) {
+	if (token_has_string(current_token.type)) {
+		free(current_token.data.name);
+	}
+}
+
+COMPONENT_PRIVATE struct token copy_token(const struct token current_token) {
+	struct token copy = current_token;
+	if (token_has_string(current_token.type)) {
+		copy.data.name = strdup(current_token.data.name);
+	}
+	return copy;
+}
+
+// move positions of recurse and jump tokens, stream part copied to other position
+COMPONENT_PRIVATE void relocate_tokens(struct token* stream, int count, int offset) {
+	for (int position = 0; position < count; position++) {
+		enum token_type type = stream[position].type;
+		if ((type == tt_recurse or type == tt_tail_recurse or type == tt_jump) and stream[position].data.integer >= 0)
+			stream[position].data.integer += offset;
+	}
+}
+
+// move tokens of appended to end of fbc and release appended, return position of first moved token
+COMPONENT_PRIVATE int append_byte_code(struct forth_byte_code* fbc, struct forth_byte_code* appended) {
+	struct token* stream = realloc(fbc->stream, (fbc->count + appended->count + 1) * sizeof(struct token));
+	if (stream == NULL) {
+		forth_release_byte_code(appended);
+		return -1;
+	}
+
+	int position = fbc->count;
+	relocate_tokens(appended->stream, appended->count, position);
+	memcpy(stream + position, appended->stream, appended->count * sizeof(struct token));
+	fbc->stream = stream;
+	fbc->count += appended->count;
+
+	appended->count = 0; // tokens moved, release only container
+	forth_release_byte_code(appended);
+	return position;
+}
+
+// compile source of lazy body as ": name body ;" at end of program, lazy token become jump to appended name
+COMPONENT_PRIVATE bool compile_lazy_body(struct forth_byte_code* program, int position) {
+	const char* name = program->stream[position - 1].data.name;
+	char* body = program->stream[position].data.string;
+	size_t source_size = strlen(name) + strlen(body) + 8;
+	char* source = malloc(source_size);
+	snprintf(source, source_size, ": %s %s ;", name, body);
+
+	struct forth_byte_code* compiled = (struct forth_byte_code*)forth_compile_optimized(source, program->optimization_level);
+	free(source);
+	if (compiled == NULL) {
+		return false;
+	}
+
+	int appended_position = append_byte_code(program, compiled);
+	if (appended_position < 0) {
+		return false;
+	}
+
+	free(body);
+	program->stream[position] = (struct token){ .type = tt_jump, .data.integer = appended_position + 1 }; // +1 name position, next token is body
+	return true;
+}
+
 typedef void(*token_iterator)(char* word, void* arg);
 
-COMPONENT_PRIVATE char* get_token(char* stream, char** next) {
-	if (not stream or strlen(stream) == 0 or (*next) == NULL) {
-		return NULL;
+// Source is read by chunks, only chunk and current word are kept in memory
+#define SOURCE_CHUNK_SIZE 512
+
+struct source_reader {
+	forth_read_function read;
+	void* context;
+	char chunk[SOURCE_CHUNK_SIZE];
+	size_t chunk_size;
+	size_t chunk_position;
+	size_t offset; // source offset of next char
+	char* word;
+	size_t word_size;
+	size_t word_capacity;
+	const char* unterminated; // comment or string not closed at end of source
+	size_t unterminated_offset;
+	bool failed; // read function returned FORTH_READ_ERROR, source is read only to offset
+};
+
+COMPONENT_PRIVATE size_t string_source(void* context, char* buffer, size_t size) {
+	const char** string = (const char**)context;
+	size_t count = 0;
+	while (count < size and (*string)[count] != '\0') {
+		count++;
+	}
+	memcpy(buffer, *string, count);
+	*string += count;
+	return count;
+}
+
+#if defined(_WIN32)
+	#include <io.h>
+	#define read_descriptor(fd, buffer, size) _read(fd, buffer, (unsigned)(size))
+#else
+	#include <unistd.h>
+	#define read_descriptor(fd, buffer, size) read(fd, buffer, size)
+#endif
+
+// read interrupted by signal is repeated, other errors stop compile
+COMPONENT_PRIVATE size_t file_source(void* context, char* buffer, size_t size) {
+	FILE* file = (FILE*)context;
+	size_t count = fread(buffer, 1, size, file);
+	while (count == 0 and ferror(file) and errno == EINTR) {
+		clearerr(file);
+		count = fread(buffer, 1, size, file);
+	}
+	return count == 0 and ferror(file) ? FORTH_READ_ERROR : count;
+}
+
+COMPONENT_PRIVATE size_t fd_source(void* context, char* buffer, size_t size) {
+	int fd = *(int*)context;
+	long count;
+	do {
+		count = (long)read_descriptor(fd, buffer, size);
+	} while (count < 0 and errno == EINTR);
+	return count < 0 ? FORTH_READ_ERROR : (size_t)count;
+}
+
+COMPONENT_PRIVATE int reader_next(struct source_reader* reader) {
+	if (reader->chunk_position == reader->chunk_size) {
+		if (reader->failed) {
+			return EOF;
+		}
+		size_t count = reader->read(reader->context, reader->chunk, sizeof(reader->chunk));
+		reader->failed = count == FORTH_READ_ERROR;
+		reader->chunk_size = reader->failed ? 0 : count;
+		reader->chunk_position = 0;
+		if (reader->chunk_size == 0) {
+			return EOF;
+		}
 	}
+	reader->offset++;
+	return (unsigned char)reader->chunk[reader->chunk_position++];
+}
 
-	while (isspace(*stream) or not isprint(*stream)) { // skip first space, tabe end new line
-		stream++;
+COMPONENT_PRIVATE void reader_push(struct source_reader* reader, char c) {
+	if (reader->word_size == reader->word_capacity) {
+		reader->word_capacity = reader->word_capacity ? reader->word_capacity * 2 : 64;
+		reader->word = realloc(reader->word, reader->word_capacity);
 	}
+	reader->word[reader->word_size++] = c;
+}
 
-	char* begin_token = stream;
-	
-	if (*stream) {
-		while(isprint(*stream) and not isspace(*stream)) {
-			if (*stream == '(') { // comments skip begin
-				while (true) {
-					if (*stream == ')') {
-						break;
-					}
-					stream++;
-				}
-				return get_token(++stream, next); 
-			}// comments skip end
-
-			if(*stream == '\"') { // string begin
-				stream++;
-				while (true) {
-					if (*stream == '\"') {
-						break;
-					}
-					stream++;
+COMPONENT_PRIVATE bool reader_unterminated(struct source_reader* reader, const char* what, size_t offset) {
+	reader->unterminated = what;
+	reader->unterminated_offset = offset;
+	return false;
+}
+
+// read word to reader->word, strings are one word with spaces, comments are skipped
+COMPONENT_PRIVATE bool reader_word(struct source_reader* reader) {
+	int c = reader_next(reader);
+	reader->word_size = 0;
+	while (c != EOF) {
+		if (isspace(c) or not isprint(c)) { // space, tab, new line end word
+			if (reader->word_size > 0) {
+				break;
+			}
+			c = reader_next(reader);
+			continue;
+		}
+
+		if (c == '(') { // comment skip with begin of word
+			size_t begin = reader->offset - 1;
+			while (c != ')') {
+				c = reader_next(reader);
+				if (c == EOF) {
+					return reader_unterminated(reader, "comment", begin);
 				}
-				stream++;
-				break; // string end
 			}
-			stream++;
+			reader->word_size = 0;
+			c = reader_next(reader);
+			continue;
 		}
-		if (strlen(stream) == 0) {
-			(*next) = NULL;
-		} else {
-			(*stream) = '\0'; // separate string to sub strings
-			stream++;
-			(*next) = stream;
+
+		reader_push(reader, (char)c);
+		if (c == '"') { // string begin
+			size_t begin = reader->offset - 1;
+			do {
+				c = reader_next(reader);
+				if (c == EOF) {
+					return reader_unterminated(reader, "string", begin);
+				}
+				reader_push(reader, (char)c);
+			} while (c != '"');
+			reader_next(reader); // char after string end is separator
+			break; // string end
 		}
-		return begin_token;
+		c = reader_next(reader);
 	}
-	return NULL;
-}
 
-COMPONENT_PRIVATE void tokens_iterator(const char* stream, token_iterator func, void* arg) {
-	char* stream_copy = strdup(stream);
-	char* iter = stream_copy;
-	char** next = &iter;// space, new line, tab
-	char* word = get_token(iter, next);
-	
-	while (word != NULL) {
-		func(word, arg);
-		word = get_token(*next, next);
+	if (reader->word_size == 0) {
+		return false;
 	}
+	reader_push(reader, '\0');
+	return true;
+}
 
-	free(stream_copy);
+COMPONENT_PRIVATE void tokens_iterator(struct source_reader* reader, token_iterator func, void* arg) {
+	while (reader_word(reader)) {
+		func(reader->word, arg);
+	}
 }
 
-COMPONENT_PRIVATE void tokens_count(char* word, void* arg) {
-	int* token_count = (int*)arg;
-	(*token_count)++;
+// token count is not known before end of stream, array grows at power of two counts
+COMPONENT_PRIVATE void push_token(struct forth_byte_code* fbc, struct token token) {
+	if (fbc->count >= 16 and (fbc->count & (fbc->count - 1)) == 0) {
+		fbc->stream = realloc(fbc->stream, sizeof(struct token) * fbc->count * 2);
+	}
+	fbc->stream[fbc->count] = token;
+	fbc->count++;
 }
 
 COMPONENT_PRIVATE void tokens_to_lexem(char* word, void* arg) {
@@ -224,17 +491,62 @@ COMPONENT_PRIVATE void tokens_to_lexem(char* word, void* arg) {
 		if (new_token.type == tt_none)
 			continue;
 
-		lexem_container->stream[lexem_container->count] = new_token;
-		lexem_container->count++;
+		push_token(lexem_container, new_token);
 		break;
 	}
 }
 
-COMPONENT_PRIVATE struct forth_byte_code* tokenizer(const char* stream) {
-	int token_count = 0;
-	tokens_iterator(stream, tokens_count, &token_count);
+struct lazy_lexer {
+	struct forth_byte_code* fbc;
+	enum { ll_top_level, ll_name, ll_body } state;
+	char* body;
+	size_t body_size;
+	size_t body_capacity;
+};
+
+// top level words are tokenized, words between name and ; are saved as source
+COMPONENT_PRIVATE void tokens_to_lazy_lexem(char* word, void* arg) {
+	struct lazy_lexer* lexer = (struct lazy_lexer*)arg;
+	switch (lexer->state) {
+	case ll_top_level:
+		if (strcmp(word, ":") == 0) {
+			lexer->state = ll_name;
+		}
+		tokens_to_lexem(word, lexer->fbc);
+		break;
+
+	case ll_name:
+		tokens_to_lexem(word, lexer->fbc);
+		lexer->state = ll_body;
+		lexer->body_size = 0;
+		break;
+
+	case ll_body:
+		if (strcmp(word, ";") == 0) {
+			if (lexer->body_size > 0) { // empty body has no lazy token, token count stay under word count
+				push_token(lexer->fbc, (struct token){ .type = tt_lazy_body, .data.string = strdup(lexer->body) });
+			}
+			tokens_to_lexem(word, lexer->fbc);
+			lexer->state = ll_top_level;
+			break;
+		}
+
+		size_t word_size = strlen(word);
+		if (lexer->body_size + word_size + 2 > lexer->body_capacity) {
+			lexer->body_capacity = (lexer->body_size + word_size + 2) * 2;
+			lexer->body = realloc(lexer->body, lexer->body_capacity);
+		}
+		if (lexer->body_size > 0) {
+			lexer->body[lexer->body_size++] = ' ';
+		}
+		memcpy(lexer->body + lexer->body_size, word, word_size + 1);
+		lexer->body_size += word_size;
+		break;
+	}
+}
 
-	struct token* tokens = calloc(token_count, sizeof(struct token));
+COMPONENT_PRIVATE struct forth_byte_code* tokenizer(struct source_reader* reader, bool lazy) {
+	struct token* tokens = calloc(16, sizeof(struct token));
 
 	struct forth_byte_code* lexem_container = (struct forth_byte_code*)malloc(sizeof(struct forth_byte_code));
 	if (lexem_container == NULL or tokens == NULL) {
@@ -243,8 +555,21 @@ COMPONENT_PRIVATE struct forth_byte_code* tokenizer(const char* stream) {
 
 	lexem_container->stream = tokens;
 	lexem_container->count = 0;
-	tokens_iterator(stream, tokens_to_lexem, lexem_container);
+	lexem_container->optimization_level = 0;
+	lexem_container->cache_entry = NULL;
+	forth_atomic_store(&lexem_container->running, 0);
+	if (lazy) {
+		struct lazy_lexer lexer = { .fbc = lexem_container, .state = ll_top_level };
+		tokens_iterator(reader, tokens_to_lazy_lexem, &lexer);
+		free(lexer.body);
+	} else {
+		tokens_iterator(reader, tokens_to_lexem, lexem_container);
+	}
+	free(reader->word);
 
+	if (lexem_container->count > 16) { // drop unused part of grown array
+		lexem_container->stream = realloc(lexem_container->stream, sizeof(struct token) * lexem_container->count);
+	}
 	return lexem_container;
 }
 
@@ -260,16 +585,33 @@ enum named_type {
 struct named_any {
 	enum named_type type;
 	const char* name;
-	int data; // pointer from variable, jump position from function, value from constant
+	forth_cell data; // pointer from variable, jump position from function, value from constant
 };
 
+#define FORTH_PROFILE_DEPTH 32 // called words kept for sampling profiler
+#if not defined(FORTH_TRACE_SIZE)
+	#define FORTH_TRACE_SIZE 64 // steps kept by trace ring, power of two
+#endif
+
+struct trace_entry {
+	int position; // token is read from program when trace is printed
+	forth_cell top; // top of data stack before step
+};
+
+#define HEAP_MIN_CLASS 1 // 2 cells, class cell and one cell for data or next free block
+#define HEAP_CLASSES 31
+
 struct forth_state {
 	// data segment
-	int* data_stack;
+	forth_cell* data_stack;
 	int data_stack_top;
 
+	// float segment
+	forth_float* float_stack;
+	int float_stack_top;
+
 	// return segment
-	int* return_stack;
+	forth_cell* return_stack;
 	int return_stack_top;
 
 	// dictionary segment
@@ -277,33 +619,74 @@ struct forth_state {
 	int dictionary_count;
 
 	// memory segment
-	int* integer_memory;
+	forth_cell* integer_memory;
 	int integer_memory_pointer_top;
+	int integer_memory_size;
+
+	// heap segment, end of integer memory
+	int heap_bottom; // first cell of heap, integer_memory_size if heap is empty
+	int heap_free[HEAP_CLASSES]; // first free block of size class, -1 if none
+	int heap_free_cells;
+	unsigned char* heap_blocks; // bit for every cell of integer memory, set at address of allocated block
 
 	// native functions
 	forth_native_function* native_functions;
 	int native_function_count;
 	void* user_data;
+
+	// interruption
+	forth_atomic_int interrupt; // set by watchdog, eval stop at next loop, until or call
+	int pc; // position to resume interrupted program
+	enum forth_status status; // status of last run
+	bool suspended; // native wait for forth_complete_pending
+
+	// message queue, ring of one host producer and script consumer
+	forth_cell* messages;
+	int messages_mask; // ring size - 1, size is power of two
+	forth_atomic_int messages_head; // next write, moved by host
+	forth_atomic_int messages_tail; // next read, moved by script
+
+	// usage counters, capacities are set by forth_make_state
+	struct forth_stats stats;
+
+#if defined(FORTH_PROFILER)
+	// position and called words for sampling profiler, written by eval, read by signal handler
+	volatile int profile_pc;
+	volatile int profile_depth;
+	volatile int profile_frames[FORTH_PROFILE_DEPTH];
+	const struct forth_byte_code* volatile profile_programs[FORTH_PROFILE_DEPTH]; // program of every frame
+#endif
+
+#if defined(FORTH_TRACE)
+	// last steps of eval
+	struct trace_entry trace[FORTH_TRACE_SIZE];
+	unsigned trace_head; // count of written steps, index of ring is masked
+#endif
 };
 
 
-COMPONENT_PRIVATE void stack_push(struct forth_state* fs, int value) {
+// depth maximums of stats are sampled where stacks grow
+COMPONENT_PRIVATE void stack_push(struct forth_state* fs, forth_cell value) {
 	int index = fs->data_stack_top;
 	fs->data_stack[index] = value;
 	fs->data_stack_top++;
+	if (fs->data_stack_top > fs->stats.data_stack_max)
+		fs->stats.data_stack_max = fs->data_stack_top;
 }
 
-COMPONENT_PRIVATE int stack_pop(struct forth_state* fs) {
+COMPONENT_PRIVATE forth_cell stack_pop(struct forth_state* fs) {
 	fs->data_stack_top--;
 	return fs->data_stack[fs->data_stack_top];
 }
 
-COMPONENT_PRIVATE void return_stack_push(struct forth_state* fs, int value) {
+COMPONENT_PRIVATE void return_stack_push(struct forth_state* fs, forth_cell value) {
 	fs->return_stack[fs->return_stack_top] = value;
 	fs->return_stack_top++;
+	if (fs->return_stack_top > fs->stats.return_stack_max)
+		fs->stats.return_stack_max = fs->return_stack_top;
 }
 
-COMPONENT_PRIVATE int return_stack_pop(struct forth_state* fs) {
+COMPONENT_PRIVATE forth_cell return_stack_pop(struct forth_state* fs) {
 	fs->return_stack_top--;
 	return fs->return_stack[fs->return_stack_top];
 }
@@ -312,9 +695,10 @@ COMPONENT_PRIVATE int return_stack_pop(struct forth_state* fs) {
 
 #define ftrue -1 // forth true
 #define ffalse 0 // forth false
+#define return_to_host -1 // return position of function called from host
 
 COMPONENT_PRIVATE void dup_op(struct forth_state* fs) {
-	int value = stack_pop(fs);
+	forth_cell value = stack_pop(fs);
 	stack_push(fs, value);
 	stack_push(fs, value);
 }
@@ -324,24 +708,24 @@ COMPONENT_PRIVATE void drop_op(struct forth_state* fs) {
 }
 
 COMPONENT_PRIVATE void swap_op(struct forth_state* fs) {
-	int value1 = stack_pop(fs);
-	int value2 = stack_pop(fs);
+	forth_cell value1 = stack_pop(fs);
+	forth_cell value2 = stack_pop(fs);
 	stack_push(fs, value1);
 	stack_push(fs, value2);
 }
 
 COMPONENT_PRIVATE void over_op(struct forth_state* fs) {
-	int value1 = stack_pop(fs);
-	int value2 = stack_pop(fs);
+	forth_cell value1 = stack_pop(fs);
+	forth_cell value2 = stack_pop(fs);
 	stack_push(fs, value2);
 	stack_push(fs, value1);
 	stack_push(fs, value2);
 }
 
 COMPONENT_PRIVATE void rot_op(struct forth_state* fs) {
-	int value1 = stack_pop(fs);
-	int value2 = stack_pop(fs);
-	int value3 = stack_pop(fs);
+	forth_cell value1 = stack_pop(fs);
+	forth_cell value2 = stack_pop(fs);
+	forth_cell value3 = stack_pop(fs);
 	stack_push(fs, value2);
 	stack_push(fs, value1);
 	stack_push(fs, value3);
@@ -351,8 +735,8 @@ COMPONENT_PRIVATE void rot_op(struct forth_state* fs) {
 
 // print value 
 COMPONENT_PRIVATE void dot_op(struct forth_state* fs) {
-	int value = stack_pop(fs);
-	printf("%d ", value); // dot operator make space
+	forth_cell value = stack_pop(fs);
+	printf("%lld ", (long long)value); // dot operator make space
 }
 
 // print char
@@ -373,37 +757,37 @@ COMPONENT_PRIVATE void do_string_op(const struct token current_token) {
 
 // ------------------------- BOOLEAN OPERATION -------------------------
 COMPONENT_PRIVATE void equal_op(struct forth_state* fs) {
-	int value1 = stack_pop(fs);
-	int value2 = stack_pop(fs);
+	forth_cell value1 = stack_pop(fs);
+	forth_cell value2 = stack_pop(fs);
 
-	int result = value2 == value1 ? ftrue : ffalse;
+	forth_cell result = value2 == value1 ? ftrue : ffalse;
 	stack_push(fs, result);
 }
 
 COMPONENT_PRIVATE void great_op(struct forth_state* fs) {
-	int value1 = stack_pop(fs);
-	int value2 = stack_pop(fs);
+	forth_cell value1 = stack_pop(fs);
+	forth_cell value2 = stack_pop(fs);
 
-	int result = value2 > value1 ? ftrue : ffalse;
+	forth_cell result = value2 > value1 ? ftrue : ffalse;
 	stack_push(fs, result);
 }
 
 COMPONENT_PRIVATE void less_op(struct forth_state* fs) {
-	int value1 = stack_pop(fs);
-	int value2 = stack_pop(fs);
+	forth_cell value1 = stack_pop(fs);
+	forth_cell value2 = stack_pop(fs);
 
-	int result = value2 < value1 ? ftrue : ffalse;
+	forth_cell result = value2 < value1 ? ftrue : ffalse;
 	stack_push(fs, result);
 }
 
 COMPONENT_PRIVATE void invert_op(struct forth_state* fs) {
-	int value = stack_pop(fs);
+	forth_cell value = stack_pop(fs);
 	stack_push(fs, ~value);
 }
 
 COMPONENT_PRIVATE void and_op(struct forth_state* fs) {
-	int value1 = stack_pop(fs);
-	int value2 = stack_pop(fs);
+	forth_cell value1 = stack_pop(fs);
+	forth_cell value2 = stack_pop(fs);
 
 	if (value1 == ftrue && value2 == ftrue) {
 		stack_push(fs, ftrue);
@@ -413,8 +797,8 @@ COMPONENT_PRIVATE void and_op(struct forth_state* fs) {
 }
 
 COMPONENT_PRIVATE void or_op(struct forth_state* fs) {
-	int value1 = stack_pop(fs);
-	int value2 = stack_pop(fs);
+	forth_cell value1 = stack_pop(fs);
+	forth_cell value2 = stack_pop(fs);
 
 	if (value1 == ftrue || value2 == ftrue) {
 		stack_push(fs, ftrue);
@@ -426,353 +810,2967 @@ COMPONENT_PRIVATE void or_op(struct forth_state* fs) {
 // ------------------------- MATH OPERATION -------------------------
 
 COMPONENT_PRIVATE void plus_op(struct forth_state* fs) {
-	int value1 = stack_pop(fs);
-	int value2 = stack_pop(fs);
+	forth_cell value1 = stack_pop(fs);
+	forth_cell value2 = stack_pop(fs);
 	stack_push(fs, value1 + value2);
 }
 
 COMPONENT_PRIVATE void minus_op(struct forth_state* fs) {
-	int value1 = stack_pop(fs);
-	int value2 = stack_pop(fs);
+	forth_cell value1 = stack_pop(fs);
+	forth_cell value2 = stack_pop(fs);
 	stack_push(fs, value2 - value1);
 }
 
 COMPONENT_PRIVATE void multiplication_op(struct forth_state* fs) {
-	int value1 = stack_pop(fs);
-	int value2 = stack_pop(fs);
+	forth_cell value1 = stack_pop(fs);
+	forth_cell value2 = stack_pop(fs);
 	stack_push(fs, value2 * value1);
 }
 
 COMPONENT_PRIVATE void dividing_op(struct forth_state* fs) {
-	int value1 = stack_pop(fs);
-	int value2 = stack_pop(fs);
+	forth_cell value1 = stack_pop(fs);
+	forth_cell value2 = stack_pop(fs);
 	stack_push(fs, value2 / value1);
 }
 
 COMPONENT_PRIVATE void mod_op(struct forth_state* fs) {
-	int value1 = stack_pop(fs);
-	int value2 = stack_pop(fs);
+	forth_cell value1 = stack_pop(fs);
+	forth_cell value2 = stack_pop(fs);
 	stack_push(fs, value2 % value1);
 }
 
 
-// ------------------------- CONTROLL FLOW OPERATIONS -------------------------
+// ------------------------- FLOAT OPERATION -------------------------
 
-COMPONENT_PRIVATE int find_controll_flow_token(const struct token* stream, int position, enum token_type incriment, enum token_type find) {
-	int temp_position = position + 1;
-	int if_stack = 0;
-	while (true) {
-		enum token_type type = stream[temp_position].type;
-		if (type == incriment) {
-			if_stack++;
-		}
+// Floats live on own stack, in memory one float take one cell (forth_float has cell size)
 
-		if (type == find) {
-			if (if_stack == 0) {
-				return temp_position;
-			} else {
-				if_stack--;
-			}
-		}
+COMPONENT_PRIVATE void float_push(struct forth_state* fs, forth_float value) {
+	fs->float_stack[fs->float_stack_top] = value;
+	fs->float_stack_top++;
+	if (fs->float_stack_top > fs->stats.float_stack_max)
+		fs->stats.float_stack_max = fs->float_stack_top;
+}
 
-		if (type == tt_semicolon) {
-			return -1;
-		}
+COMPONENT_PRIVATE forth_float float_pop(struct forth_state* fs) {
+	fs->float_stack_top--;
+	return fs->float_stack[fs->float_stack_top];
+}
 
-		temp_position++;
+#if defined(FORTH_WORDS_FLOAT)
+COMPONENT_PRIVATE void float_math_op(struct forth_state* fs, enum token_type type) {
+	forth_float value1 = float_pop(fs);
+	forth_float value2 = float_pop(fs);
+	switch (type) {
+	case tt_fplus:
+		float_push(fs, value2 + value1);
+		break;
+	case tt_fminus:
+		float_push(fs, value2 - value1);
+		break;
+	case tt_fmultip:
+		float_push(fs, value2 * value1);
+		break;
+	case tt_fdiv:
+		float_push(fs, value2 / value1);
+		break;
+	case tt_fless: // ( r1 r2 -- ) ( -- flag )
+		stack_push(fs, value2 < value1 ? ftrue : ffalse);
+		break;
+	case tt_fequal:
+		stack_push(fs, value2 == value1 ? ftrue : ffalse);
+		break;
+	default:
+		break;
 	}
 }
 
+COMPONENT_PRIVATE void fswap_op(struct forth_state* fs) {
+	forth_float value1 = float_pop(fs);
+	forth_float value2 = float_pop(fs);
+	float_push(fs, value1);
+	float_push(fs, value2);
+}
 
-COMPONENT_PRIVATE int if_op(struct forth_state* fs, const struct token* stream, int position) {
-	int cmp = stack_pop(fs);
+COMPONENT_PRIVATE void float_get_op(struct forth_state* fs) { // ( addr -- ) ( -- r )
+	forth_cell pointer = stack_pop(fs);
+	forth_float value;
+	memcpy(&value, fs->integer_memory + pointer, sizeof(value));
+	float_push(fs, value);
+}
 
-	int find_else = find_controll_flow_token(stream, position, tt_if, tt_else);
-	int find_then = find_controll_flow_token(stream, position, tt_if, tt_then);
+COMPONENT_PRIVATE void float_set_op(struct forth_state* fs) { // ( addr -- ) ( r -- )
+	forth_cell pointer = stack_pop(fs);
+	forth_float value = float_pop(fs);
+	memcpy(fs->integer_memory + pointer, &value, sizeof(value));
+}
 
-	if (cmp == ftrue) {
-		if(find_else > 0){
-			return_stack_push(fs, find_then);
-		}
-		return position;
-	}
+COMPONENT_PRIVATE void float_dot_op(struct forth_state* fs) {
+	printf("%g ", (double)float_pop(fs));
+}
+#endif
 
-	if (find_else > 0) {
-		return find_else;
-	} else {
-		return find_then;
-	}
+// ------------------------- BULK MEMORY OPERATION -------------------------
+
+// Array words work on ranges of integer_memory in one dispatch.
+// Every kernel has a scalar version, SSE2 and AVX2 versions are picked at runtime from cpu features.
+// Simd kernels work on 32 bit lanes, wider cells use scalar kernels.
+
+#if FORTH_CELL_BITS == 64
+	typedef uint64_t forth_ucell; // wrap around arithmetic
+#else
+	typedef uint32_t forth_ucell;
+#endif
+
+#if FORTH_CELL_BITS == 32 and (defined(__x86_64__) or defined(_M_X64) or defined(__i386__) or defined(_M_IX86))
+	#define FORTH_X86
+	#include <immintrin.h>
+	#if defined(_MSC_VER) and not defined(__clang__)
+		#include <intrin.h>
+		#define FORTH_TARGET_AVX2
+	#else
+		#define FORTH_TARGET_AVX2 __attribute__((target("avx2")))
+	#endif
+	#if defined(__SSE2__) or defined(_M_X64) or (defined(_M_IX86_FP) and _M_IX86_FP >= 2)
+		#define FORTH_SSE2
+	#endif
+	#define FORTH_AVX2
+#endif
+
+enum bulk_level {
+	bulk_scalar,
+	bulk_sse2,
+	bulk_avx2,
+};
+
+struct bulk_kernels {
+	void (*fill)(forth_cell* dst, int count, forth_cell value);
+	forth_cell (*sum)(const forth_cell* src, int count);
+	forth_cell (*min)(const forth_cell* src, int count);
+	forth_cell (*max)(const forth_cell* src, int count);
+	void (*add)(const forth_cell* src1, const forth_cell* src2, forth_cell* dst, int count);
+	void (*mul)(const forth_cell* src1, const forth_cell* src2, forth_cell* dst, int count);
+	void (*equal)(const forth_cell* src1, const forth_cell* src2, forth_cell* dst, int count);
+	int (*search)(const forth_cell* src, int count, forth_cell value); // index or -1
+};
+
+// scalar kernels, also used for tails of simd kernels
+COMPONENT_PRIVATE void fill_scalar(forth_cell* dst, int count, forth_cell value) {
+	for (int i = 0; i < count; i++)
+		dst[i] = value;
 }
 
-COMPONENT_PRIVATE void dictionary_add_from_name(struct forth_state* fs, const char* name, enum named_type type, int data) {
-	fs->dictionary[fs->dictionary_count] = (struct named_any){ .name = name, .data = data, .type = type };
-	fs->dictionary_count++;
+COMPONENT_PRIVATE forth_cell sum_scalar(const forth_cell* src, int count) {
+	forth_ucell sum = 0; // wrap around like simd lanes
+	for (int i = 0; i < count; i++)
+		sum += (forth_ucell)src[i];
+	return (forth_cell)sum;
 }
 
-COMPONENT_PRIVATE int dictionary_add_from_token(struct forth_state* fs, const struct token* stream, int position, enum named_type type, int data) {
-	const struct token name_token = stream[position + 1];
-	dictionary_add_from_name(fs, name_token.data.name, type, data);
-	if (type == nt_function) {
-		return find_controll_flow_token(stream, position, tt_none, tt_semicolon); // skip function body
-	} else {
-		return position + 1;
-	}
+COMPONENT_PRIVATE forth_cell min_scalar(const forth_cell* src, int count) {
+	forth_cell value = src[0];
+	for (int i = 1; i < count; i++)
+		value = src[i] < value ? src[i] : value;
+	return value;
 }
 
-COMPONENT_PRIVATE bool dictionary_get_push(struct forth_state* fs, const char* name) {
-	for (int i = 0; i < fs->dictionary_count; i++) {
-		const struct named_any current = fs->dictionary[i];
-		if (strcmp(current.name, name) == 0) {
-			stack_push(fs, current.data);
-			stack_push(fs, current.type);
-			return true;
-		}
-	}
-	return false;
+COMPONENT_PRIVATE forth_cell max_scalar(const forth_cell* src, int count) {
+	forth_cell value = src[0];
+	for (int i = 1; i < count; i++)
+		value = src[i] > value ? src[i] : value;
+	return value;
 }
 
-COMPONENT_PRIVATE void allot_op(struct forth_state* fs) {
-	int offset = stack_pop(fs);
-	fs->integer_memory_pointer_top += offset;
+COMPONENT_PRIVATE void add_scalar(const forth_cell* src1, const forth_cell* src2, forth_cell* dst, int count) {
+	for (int i = 0; i < count; i++)
+		dst[i] = (forth_cell)((forth_ucell)src1[i] + (forth_ucell)src2[i]);
 }
 
-COMPONENT_PRIVATE int do_loop_start(struct forth_state* fs, const struct token* stream, int position) { // TODO rewrite danger with push stack and next loop
-	int start_index = stack_pop(fs);
-	int end_index = stack_pop(fs);
+COMPONENT_PRIVATE void mul_scalar(const forth_cell* src1, const forth_cell* src2, forth_cell* dst, int count) {
+	for (int i = 0; i < count; i++)
+		dst[i] = (forth_cell)((forth_ucell)src1[i] * (forth_ucell)src2[i]);
+}
 
-	if (start_index < end_index) {
-		return_stack_push(fs, position);
-		return_stack_push(fs, end_index);
-		return_stack_push(fs, start_index);
-		return position;
-	} else {
-		return find_controll_flow_token(stream, position, tt_do, tt_loop);
+COMPONENT_PRIVATE void equal_scalar(const forth_cell* src1, const forth_cell* src2, forth_cell* dst, int count) {
+	for (int i = 0; i < count; i++)
+		dst[i] = src1[i] == src2[i] ? -1 : 0;
+}
+
+COMPONENT_PRIVATE int search_scalar(const forth_cell* src, int count, forth_cell value) {
+	for (int i = 0; i < count; i++) {
+		if (src[i] == value)
+			return i;
 	}
+	return -1;
 }
 
-COMPONENT_PRIVATE int do_loop_end(struct forth_state* fs, const struct token* stream, int position) {
-	int start_index = return_stack_pop(fs);
-	int end_index = return_stack_pop(fs);
-	int do_position = return_stack_pop(fs);
+static const struct bulk_kernels bulk_kernels_scalar = {
+	fill_scalar, sum_scalar, min_scalar, max_scalar, add_scalar, mul_scalar, equal_scalar, search_scalar
+};
 
-	start_index++;
+#ifdef FORTH_SSE2
+COMPONENT_PRIVATE void fill_sse2(forth_cell* dst, int count, forth_cell value) {
+	__m128i v = _mm_set1_epi32(value);
+	int i = 0;
+	for (; i + 4 <= count; i += 4)
+		_mm_storeu_si128((__m128i*)(dst + i), v);
+	fill_scalar(dst + i, count - i, value);
+}
 
-	if (start_index < end_index) {
-		return_stack_push(fs, do_position);
-		return_stack_push(fs, end_index);
-		return_stack_push(fs, start_index);
-		return do_position;
-	} else {
-		return position;
-	}
+COMPONENT_PRIVATE forth_cell sum_sse2(const forth_cell* src, int count) {
+	__m128i acc = _mm_setzero_si128();
+	int i = 0;
+	for (; i + 4 <= count; i += 4)
+		acc = _mm_add_epi32(acc, _mm_loadu_si128((const __m128i*)(src + i)));
+
+	forth_cell lanes[4];
+	_mm_storeu_si128((__m128i*)lanes, acc);
+	return sum_scalar(lanes, 4) + sum_scalar(src + i, count - i);
 }
 
-COMPONENT_PRIVATE void loop_index_push(struct forth_state* fs) {
-	int i = return_stack_pop(fs);
-	stack_push(fs, i);
-	return_stack_push(fs, i);
+// sse2 has no min/max for 32 bit lanes, select by compare mask
+COMPONENT_PRIVATE __m128i select_sse2(__m128i mask, __m128i a, __m128i b) {
+	return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
 }
 
-COMPONENT_PRIVATE void set_value(struct forth_state* fs) {
-	int pointer = stack_pop(fs);
-	fs->integer_memory[pointer] = stack_pop(fs);
+COMPONENT_PRIVATE forth_cell min_sse2(const forth_cell* src, int count) {
+	if (count < 4)
+		return min_scalar(src, count);
+
+	__m128i acc = _mm_loadu_si128((const __m128i*)src);
+	int i = 4;
+	for (; i + 4 <= count; i += 4) {
+		__m128i v = _mm_loadu_si128((const __m128i*)(src + i));
+		acc = select_sse2(_mm_cmplt_epi32(v, acc), v, acc);
+	}
+
+	forth_cell lanes[4];
+	_mm_storeu_si128((__m128i*)lanes, acc);
+	forth_cell value = min_scalar(lanes, 4);
+	if (i < count) {
+		forth_cell tail = min_scalar(src + i, count - i);
+		value = tail < value ? tail : value;
+	}
+	return value;
 }
 
-COMPONENT_PRIVATE void get_value_of_variable(struct forth_state* fs) { // at @
-	int pointer = stack_pop(fs);
-	stack_push(fs, fs->integer_memory[pointer]);
+COMPONENT_PRIVATE forth_cell max_sse2(const forth_cell* src, int count) {
+	if (count < 4)
+		return max_scalar(src, count);
+
+	__m128i acc = _mm_loadu_si128((const __m128i*)src);
+	int i = 4;
+	for (; i + 4 <= count; i += 4) {
+		__m128i v = _mm_loadu_si128((const __m128i*)(src + i));
+		acc = select_sse2(_mm_cmpgt_epi32(v, acc), v, acc);
+	}
+
+	forth_cell lanes[4];
+	_mm_storeu_si128((__m128i*)lanes, acc);
+	forth_cell value = max_scalar(lanes, 4);
+	if (i < count) {
+		forth_cell tail = max_scalar(src + i, count - i);
+		value = tail > value ? tail : value;
+	}
+	return value;
 }
 
-COMPONENT_PRIVATE int until_op(struct forth_state* fs, int current_pos) { // return jump position
-	int value = stack_pop(fs);
-	if (value == ftrue) {
-		return return_stack_pop(fs);
-	} else {
-		return_stack_pop(fs);
-		return current_pos;
+COMPONENT_PRIVATE void add_sse2(const forth_cell* src1, const forth_cell* src2, forth_cell* dst, int count) {
+	int i = 0;
+	for (; i + 4 <= count; i += 4) {
+		__m128i a = _mm_loadu_si128((const __m128i*)(src1 + i));
+		__m128i b = _mm_loadu_si128((const __m128i*)(src2 + i));
+		_mm_storeu_si128((__m128i*)(dst + i), _mm_add_epi32(a, b));
 	}
+	add_scalar(src1 + i, src2 + i, dst + i, count - i);
 }
 
-COMPONENT_PRIVATE int ident_op(struct forth_state* fs, const char* name, int position) {
-	if (not dictionary_get_push(fs, name)) { // push data and type to stack
-		printf("Error name constant/variable/function nor found, what is: %s ?", name);
-		return;
+COMPONENT_PRIVATE void mul_sse2(const forth_cell* src1, const forth_cell* src2, forth_cell* dst, int count) {
+	int i = 0;
+	for (; i + 4 <= count; i += 4) { // sse2 has no mullo_epi32, multiply even and odd lanes
+		__m128i a = _mm_loadu_si128((const __m128i*)(src1 + i));
+		__m128i b = _mm_loadu_si128((const __m128i*)(src2 + i));
+		__m128i even = _mm_mul_epu32(a, b);
+		__m128i odd = _mm_mul_epu32(_mm_srli_si128(a, 4), _mm_srli_si128(b, 4));
+		__m128i result = _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)), _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+		_mm_storeu_si128((__m128i*)(dst + i), result);
 	}
+	mul_scalar(src1 + i, src2 + i, dst + i, count - i);
+}
 
-	// is type function jump to func body
-	int ident_type = stack_pop(fs);
-	if (ident_type == (int)nt_function) {
-		return_stack_push(fs, position);
-		return stack_pop(fs);
+COMPONENT_PRIVATE void equal_sse2(const forth_cell* src1, const forth_cell* src2, forth_cell* dst, int count) {
+	int i = 0;
+	for (; i + 4 <= count; i += 4) {
+		__m128i a = _mm_loadu_si128((const __m128i*)(src1 + i));
+		__m128i b = _mm_loadu_si128((const __m128i*)(src2 + i));
+		_mm_storeu_si128((__m128i*)(dst + i), _mm_cmpeq_epi32(a, b));
 	}
+	equal_scalar(src1 + i, src2 + i, dst + i, count - i);
+}
 
-	if (ident_type == (int)nt_function_native) {
-		int native_function_index = stack_pop(fs);
-		fs->native_functions[native_function_index](fs);
+COMPONENT_PRIVATE int search_sse2(const forth_cell* src, int count, forth_cell value) {
+	__m128i v = _mm_set1_epi32(value);
+	int i = 0;
+	for (; i + 4 <= count; i += 4) {
+		__m128i found = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i*)(src + i)), v);
+		if (_mm_movemask_epi8(found))
+			return i + search_scalar(src + i, 4, value);
 	}
-	return position;
+	int tail = search_scalar(src + i, count - i, value);
+	return tail < 0 ? -1 : i + tail;
 }
 
-COMPONENT_PRIVATE void eval(struct forth_state* fs, const struct token* stream, int start_position, int end_poition) {
-	for (int current_pos = start_position; current_pos < end_poition; current_pos++) {
-		const struct token current_token = stream[current_pos];
-		enum token_type current_token_type = current_token.type;
+static const struct bulk_kernels bulk_kernels_sse2 = {
+	fill_sse2, sum_sse2, min_sse2, max_sse2, add_sse2, mul_sse2, equal_sse2, search_sse2
+};
+#endif // FORTH_SSE2
+
+#ifdef FORTH_AVX2
+FORTH_TARGET_AVX2 COMPONENT_PRIVATE void fill_avx2(forth_cell* dst, int count, forth_cell value) {
+	__m256i v = _mm256_set1_epi32(value);
+	int i = 0;
+	for (; i + 8 <= count; i += 8)
+		_mm256_storeu_si256((__m256i*)(dst + i), v);
+	fill_scalar(dst + i, count - i, value);
+}
 
-		switch (current_token_type) {
-		case tt_dup:
-			dup_op(fs);
-			break;
+FORTH_TARGET_AVX2 COMPONENT_PRIVATE forth_cell sum_avx2(const forth_cell* src, int count) {
+	__m256i acc = _mm256_setzero_si256();
+	int i = 0;
+	for (; i + 8 <= count; i += 8)
+		acc = _mm256_add_epi32(acc, _mm256_loadu_si256((const __m256i*)(src + i)));
 
-		case tt_drop:
-			drop_op(fs);
-			break;
+	forth_cell lanes[8];
+	_mm256_storeu_si256((__m256i*)lanes, acc);
+	return sum_scalar(lanes, 8) + sum_scalar(src + i, count - i);
+}
 
-		case tt_swap:
-			swap_op(fs);
-			break;
+FORTH_TARGET_AVX2 COMPONENT_PRIVATE forth_cell min_avx2(const forth_cell* src, int count) {
+	if (count < 8)
+		return min_scalar(src, count);
+
+	__m256i acc = _mm256_loadu_si256((const __m256i*)src);
+	int i = 8;
+	for (; i + 8 <= count; i += 8)
+		acc = _mm256_min_epi32(acc, _mm256_loadu_si256((const __m256i*)(src + i)));
+
+	forth_cell lanes[8];
+	_mm256_storeu_si256((__m256i*)lanes, acc);
+	forth_cell value = min_scalar(lanes, 8);
+	if (i < count) {
+		forth_cell tail = min_scalar(src + i, count - i);
+		value = tail < value ? tail : value;
+	}
+	return value;
+}
 
-		case tt_over:
-			over_op(fs);
-			break;
+FORTH_TARGET_AVX2 COMPONENT_PRIVATE forth_cell max_avx2(const forth_cell* src, int count) {
+	if (count < 8)
+		return max_scalar(src, count);
+
+	__m256i acc = _mm256_loadu_si256((const __m256i*)src);
+	int i = 8;
+	for (; i + 8 <= count; i += 8)
+		acc = _mm256_max_epi32(acc, _mm256_loadu_si256((const __m256i*)(src + i)));
+
+	forth_cell lanes[8];
+	_mm256_storeu_si256((__m256i*)lanes, acc);
+	forth_cell value = max_scalar(lanes, 8);
+	if (i < count) {
+		forth_cell tail = max_scalar(src + i, count - i);
+		value = tail > value ? tail : value;
+	}
+	return value;
+}
 
-		case tt_rot:
-			rot_op(fs);
+FORTH_TARGET_AVX2 COMPONENT_PRIVATE void add_avx2(const forth_cell* src1, const forth_cell* src2, forth_cell* dst, int count) {
+	int i = 0;
+	for (; i + 8 <= count; i += 8) {
+		__m256i a = _mm256_loadu_si256((const __m256i*)(src1 + i));
+		__m256i b = _mm256_loadu_si256((const __m256i*)(src2 + i));
+		_mm256_storeu_si256((__m256i*)(dst + i), _mm256_add_epi32(a, b));
+	}
+	add_scalar(src1 + i, src2 + i, dst + i, count - i);
+}
+
+FORTH_TARGET_AVX2 COMPONENT_PRIVATE void mul_avx2(const forth_cell* src1, const forth_cell* src2, forth_cell* dst, int count) {
+	int i = 0;
+	for (; i + 8 <= count; i += 8) {
+		__m256i a = _mm256_loadu_si256((const __m256i*)(src1 + i));
+		__m256i b = _mm256_loadu_si256((const __m256i*)(src2 + i));
+		_mm256_storeu_si256((__m256i*)(dst + i), _mm256_mullo_epi32(a, b));
+	}
+	mul_scalar(src1 + i, src2 + i, dst + i, count - i);
+}
+
+FORTH_TARGET_AVX2 COMPONENT_PRIVATE void equal_avx2(const forth_cell* src1, const forth_cell* src2, forth_cell* dst, int count) {
+	int i = 0;
+	for (; i + 8 <= count; i += 8) {
+		__m256i a = _mm256_loadu_si256((const __m256i*)(src1 + i));
+		__m256i b = _mm256_loadu_si256((const __m256i*)(src2 + i));
+		_mm256_storeu_si256((__m256i*)(dst + i), _mm256_cmpeq_epi32(a, b));
+	}
+	equal_scalar(src1 + i, src2 + i, dst + i, count - i);
+}
+
+FORTH_TARGET_AVX2 COMPONENT_PRIVATE int search_avx2(const forth_cell* src, int count, forth_cell value) {
+	__m256i v = _mm256_set1_epi32(value);
+	int i = 0;
+	for (; i + 8 <= count; i += 8) {
+		__m256i found = _mm256_cmpeq_epi32(_mm256_loadu_si256((const __m256i*)(src + i)), v);
+		if (_mm256_movemask_epi8(found))
+			return i + search_scalar(src + i, 8, value);
+	}
+	int tail = search_scalar(src + i, count - i, value);
+	return tail < 0 ? -1 : i + tail;
+}
+
+static const struct bulk_kernels bulk_kernels_avx2 = {
+	fill_avx2, sum_avx2, min_avx2, max_avx2, add_avx2, mul_avx2, equal_avx2, search_avx2
+};
+#endif // FORTH_AVX2
+
+COMPONENT_PRIVATE enum bulk_level bulk_cpu_level() {
+#ifdef FORTH_AVX2
+	#if defined(_MSC_VER) and not defined(__clang__)
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] >= 7) {
+		__cpuid(info, 1);
+		bool os_ymm = (info[2] & (1 << 27)) and (_xgetbv(0) & 6) == 6; // osxsave and ymm state enabled
+		__cpuidex(info, 7, 0);
+		if (os_ymm and (info[1] & (1 << 5)))
+			return bulk_avx2;
+	}
+	#else
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+		return bulk_avx2;
+	#endif
+#endif
+#ifdef FORTH_SSE2
+	return bulk_sse2;
+#else
+	return bulk_scalar;
+#endif
+}
+
+// kernels of level, level is supported by cpu
+COMPONENT_PRIVATE const struct bulk_kernels* bulk_kernels_of(enum bulk_level level) {
+	switch (level) {
+#ifdef FORTH_AVX2
+	case bulk_avx2:
+		return &bulk_kernels_avx2;
+#endif
+#ifdef FORTH_SSE2
+	case bulk_sse2:
+		return &bulk_kernels_sse2;
+#endif
+	default:
+		return &bulk_kernels_scalar;
+	}
+}
+
+// level not above level and cpu support
+COMPONENT_PRIVATE enum bulk_level bulk_supported_level(enum bulk_level level) {
+	enum bulk_level cpu_level = bulk_cpu_level();
+	return level < cpu_level ? level : cpu_level;
+}
+
+static forth_atomic_int bulk_active_level = -1; // selected on first use, threads racing on first use store same level
+
+COMPONENT_PRIVATE const struct bulk_kernels* bulk() {
+	int level = (int)forth_atomic_load(&bulk_active_level);
+	if (level < 0) {
+		level = bulk_supported_level(bulk_avx2);
+		forth_atomic_store(&bulk_active_level, level);
+	}
+	return bulk_kernels_of((enum bulk_level)level);
+}
+
+#ifdef FORTH_TEST_COMPONENTS
+// test hook: select kernels not above level and cpu support, return selected level, -1 select on next use
+int bulk_set_level(int level) {
+	enum bulk_level selected = bulk_supported_level((enum bulk_level)level);
+	forth_atomic_store(&bulk_active_level, selected);
+	return selected;
+}
+
+int bulk_get_level() {
+	return (int)forth_atomic_load(&bulk_active_level);
+}
+#endif
+
+#if defined(FORTH_WORDS_BULK)
+// simd kernels read a block before write, element-wise words with shifted overlap must stay sequential
+COMPONENT_PRIVATE bool ranges_shifted_overlap(int src, int dst, int count) {
+	return src != dst and src < dst + count and dst < src + count;
+}
+
+COMPONENT_PRIVATE void fill_op(struct forth_state* fs) { // ( addr n value -- )
+	forth_cell value = stack_pop(fs);
+	int count = (int)stack_pop(fs);
+	int addr = (int)stack_pop(fs);
+	if (count > 0)
+		bulk()->fill(fs->integer_memory + addr, count, value);
+}
+
+COMPONENT_PRIVATE void move_op(struct forth_state* fs) { // ( src dst n -- )
+	int count = (int)stack_pop(fs);
+	int dst = (int)stack_pop(fs);
+	int src = (int)stack_pop(fs);
+	if (count > 0)
+		memmove(fs->integer_memory + dst, fs->integer_memory + src, count * sizeof(*fs->integer_memory));
+}
+
+COMPONENT_PRIVATE void cmove_op(struct forth_state* fs) { // ( src dst n -- ) copy from low to high address
+	int count = (int)stack_pop(fs);
+	int dst = (int)stack_pop(fs);
+	int src = (int)stack_pop(fs);
+	if (count <= 0)
+		return;
+
+	if (dst <= src or dst >= src + count) {
+		memmove(fs->integer_memory + dst, fs->integer_memory + src, count * sizeof(*fs->integer_memory));
+		return;
+	}
+
+	for (int i = 0; i < count; i++) // overlap propagate values like forth cmove
+		fs->integer_memory[dst + i] = fs->integer_memory[src + i];
+}
+
+COMPONENT_PRIVATE void sum_op(struct forth_state* fs) { // ( addr n -- sum )
+	int count = (int)stack_pop(fs);
+	int addr = (int)stack_pop(fs);
+	stack_push(fs, count > 0 ? bulk()->sum(fs->integer_memory + addr, count) : 0);
+}
+
+COMPONENT_PRIVATE void array_min_op(struct forth_state* fs) { // ( addr n -- min )
+	int count = (int)stack_pop(fs);
+	int addr = (int)stack_pop(fs);
+	stack_push(fs, count > 0 ? bulk()->min(fs->integer_memory + addr, count) : 0);
+}
+
+COMPONENT_PRIVATE void array_max_op(struct forth_state* fs) { // ( addr n -- max )
+	int count = (int)stack_pop(fs);
+	int addr = (int)stack_pop(fs);
+	stack_push(fs, count > 0 ? bulk()->max(fs->integer_memory + addr, count) : 0);
+}
+
+typedef void (*bulk_binary_kernel)(const forth_cell* src1, const forth_cell* src2, forth_cell* dst, int count);
+
+COMPONENT_PRIVATE void array_binary_op(struct forth_state* fs, bulk_binary_kernel kernel, bulk_binary_kernel scalar) { // ( src1 src2 dst n -- )
+	int count = (int)stack_pop(fs);
+	int dst = (int)stack_pop(fs);
+	int src2 = (int)stack_pop(fs);
+	int src1 = (int)stack_pop(fs);
+	if (count <= 0)
+		return;
+
+	if (ranges_shifted_overlap(src1, dst, count) or ranges_shifted_overlap(src2, dst, count))
+		kernel = scalar;
+	kernel(fs->integer_memory + src1, fs->integer_memory + src2, fs->integer_memory + dst, count);
+}
+
+COMPONENT_PRIVATE void array_plus_op(struct forth_state* fs) {
+	array_binary_op(fs, bulk()->add, add_scalar);
+}
+
+COMPONENT_PRIVATE void array_multip_op(struct forth_state* fs) {
+	array_binary_op(fs, bulk()->mul, mul_scalar);
+}
+
+COMPONENT_PRIVATE void array_equal_op(struct forth_state* fs) {
+	array_binary_op(fs, bulk()->equal, equal_scalar);
+}
+
+COMPONENT_PRIVATE void search_op(struct forth_state* fs) { // ( addr n value -- index ) index -1 if not found
+	forth_cell value = stack_pop(fs);
+	int count = (int)stack_pop(fs);
+	int addr = (int)stack_pop(fs);
+	stack_push(fs, count > 0 ? bulk()->search(fs->integer_memory + addr, count, value) : -1);
+}
+#endif
+
+
+// ------------------------- MESSAGE OPERATION -------------------------
+
+#if defined(FORTH_WORDS_MESSAGE)
+// push next message, 0 if queue is empty
+COMPONENT_PRIVATE void receive_op(struct forth_state* fs) {
+	int tail = forth_atomic_load(&fs->messages_tail);
+	if (fs->messages == NULL or tail == forth_atomic_load(&fs->messages_head)) {
+		stack_push(fs, 0);
+		return;
+	}
+	forth_cell message = fs->messages[tail];
+	forth_atomic_store(&fs->messages_tail, (tail + 1) & fs->messages_mask);
+	stack_push(fs, message);
+}
+
+COMPONENT_PRIVATE void message_ready_op(struct forth_state* fs) {
+	bool ready = fs->messages != NULL and forth_atomic_load(&fs->messages_tail) != forth_atomic_load(&fs->messages_head);
+	stack_push(fs, ready ? ftrue : ffalse);
+}
+#endif
+
+// ------------------------- HEAP OPERATION -------------------------
+#if defined(FORTH_WORDS_HEAP)
+
+// allocate, free and resize take blocks from end of integer memory, heap grows down to allot memory.
+// Block of class k is 2^k cells, first cell keep class (~class when block is free), address is next cell.
+// Free blocks are kept in list of their class, next free block is in first cell of address.
+// Bit map of state mark addresses of allocated blocks, free and resize check address without walk over heap.
+
+#define ior_ok 0
+#define ior_fail -1
+
+COMPONENT_PRIVATE int heap_class(forth_cell size) {
+	int class = HEAP_MIN_CLASS;
+	while (((forth_cell)1 << class) - 1 < size) { // -1 class cell
+		class++;
+	}
+	return class;
+}
+
+COMPONENT_PRIVATE void heap_mark(struct forth_state* fs, int address, bool allocated) {
+	unsigned char bit = (unsigned char)(1 << (address % 8));
+	fs->heap_blocks[address / 8] = allocated ? fs->heap_blocks[address / 8] | bit : fs->heap_blocks[address / 8] & ~bit;
+}
+
+// address is allocated block only if it is in heap and marked, class cell overwritten by script is refused
+COMPONENT_PRIVATE bool heap_is_block(struct forth_state* fs, forth_cell address, int* class) {
+	if (address <= fs->heap_bottom or address >= fs->integer_memory_size or not (fs->heap_blocks[address / 8] & (1 << (address % 8)))) {
+		return false;
+	}
+	forth_cell header = fs->integer_memory[address - 1];
+	if (header < HEAP_MIN_CLASS or header >= HEAP_CLASSES or ((forth_cell)1 << header) > fs->integer_memory_size - (address - 1)) {
+		return false;
+	}
+	*class = (int)header;
+	return true;
+}
+
+// return address of block or -1 if heap meet allot memory
+COMPONENT_PRIVATE int heap_allocate(struct forth_state* fs, forth_cell size) {
+	if (size < 0 or size >= ((forth_cell)1 << (HEAP_CLASSES - 1))) {
+		return -1;
+	}
+	int class = heap_class(size);
+	int block_size = 1 << class;
+	int address = fs->heap_free[class];
+	if (address >= 0) { // reuse free block
+		fs->heap_free[class] = (int)fs->integer_memory[address];
+		fs->heap_free_cells -= block_size;
+	} else {
+		if (fs->heap_bottom - block_size < fs->integer_memory_pointer_top) {
+			return -1;
+		}
+		fs->heap_bottom -= block_size;
+		address = fs->heap_bottom + 1;
+	}
+	fs->integer_memory[address - 1] = class;
+	heap_mark(fs, address, true);
+	return address;
+}
+
+COMPONENT_PRIVATE void heap_release(struct forth_state* fs, int address, int class) {
+	fs->integer_memory[address - 1] = ~class;
+	heap_mark(fs, address, false);
+	fs->integer_memory[address] = fs->heap_free[class];
+	fs->heap_free[class] = address;
+	fs->heap_free_cells += 1 << class;
+}
+
+COMPONENT_PRIVATE void allocate_op(struct forth_state* fs) {
+	int address = heap_allocate(fs, stack_pop(fs));
+	stack_push(fs, address);
+	stack_push(fs, address < 0 ? ior_fail : ior_ok);
+}
+
+COMPONENT_PRIVATE void free_op(struct forth_state* fs) {
+	forth_cell address = stack_pop(fs);
+	int class;
+	if (not heap_is_block(fs, address, &class)) { // not allocated or freed already
+		stack_push(fs, ior_fail);
+		return;
+	}
+	heap_release(fs, (int)address, class);
+	stack_push(fs, ior_ok);
+}
+
+// block keep address while new size fit in class, else content move to new block
+COMPONENT_PRIVATE void resize_op(struct forth_state* fs) {
+	forth_cell size = stack_pop(fs);
+	forth_cell address = stack_pop(fs);
+	int class;
+	if (not heap_is_block(fs, address, &class) or size < 0) {
+		stack_push(fs, address);
+		stack_push(fs, ior_fail);
+		return;
+	}
+	if (size < ((forth_cell)1 << class)) {
+		stack_push(fs, address);
+		stack_push(fs, ior_ok);
+		return;
+	}
+
+	int moved = heap_allocate(fs, size);
+	if (moved < 0) { // old block stay valid
+		stack_push(fs, address);
+		stack_push(fs, ior_fail);
+		return;
+	}
+	memcpy(fs->integer_memory + moved, fs->integer_memory + address, (((size_t)1 << class) - 1) * sizeof(forth_cell));
+	heap_release(fs, (int)address, class);
+	stack_push(fs, moved);
+	stack_push(fs, ior_ok);
+}
+#endif
+
+// ------------------------- TRACE -------------------------
+
+// FORTH_TRACE build: eval write position and top of data stack of every step to ring of state,
+// ring keep last FORTH_TRACE_SIZE steps and is printed on error or by forth_trace_dump.
+
+#if defined(FORTH_PROFILER) or defined(FORTH_TRACE)
+
+// label of token, key words by source word
+COMPONENT_PRIVATE const char* token_label(const struct token* token) {
+	if (token->type < tt_ident) {
+		return token_names[token->type];
+	}
+	switch (token->type) {
+	case tt_ident:
+	case tt_tail_call:
+		return token->data.name;
+	case tt_value:
+	case tt_float_value:
+		return "literal";
+	case tt_dotstring:
+		return ".\"";
+	default:
+		return "jump";
+	}
+}
+
+#endif
+
+#if defined(FORTH_TRACE)
+
+// no branch: ring index is masked, top of empty stack read first cell (select, not jump)
+#define trace_step(fs, step_position) do { \
+	struct trace_entry* entry = &(fs)->trace[(fs)->trace_head++ & (FORTH_TRACE_SIZE - 1)]; \
+	entry->position = (step_position); \
+	entry->top = (fs)->data_stack[(fs)->data_stack_top > 0 ? (fs)->data_stack_top - 1 : 0]; \
+} while (0)
+
+// name of word around position
+COMPONENT_PRIVATE const char* trace_word(const struct forth_byte_code* program, int position) {
+	for (int i = position - 1; i >= 0; i--) {
+		if (program->stream[i].type == tt_semicolon)
+			break;
+		if (program->stream[i].type == tt_function and program->stream[i + 1].type == tt_ident)
+			return program->stream[i + 1].data.name;
+	}
+	return "top level";
+}
+
+COMPONENT_PRIVATE void trace_print(struct forth_state* fs, const struct forth_byte_code* program, FILE* output) {
+	unsigned count = fs->trace_head < FORTH_TRACE_SIZE ? fs->trace_head : FORTH_TRACE_SIZE;
+	fprintf(output, "Trace of last %u steps:\n", count);
+	for (unsigned step = fs->trace_head - count; step != fs->trace_head; step++) {
+		const struct trace_entry* entry = &fs->trace[step & (FORTH_TRACE_SIZE - 1)];
+		if (entry->position >= program->count) { // step of other program
+			fprintf(output, "%6d ?\n", entry->position);
+			continue;
+		}
+		fprintf(output, "%6d %-16s %-12s %lld\n", entry->position, trace_word(program, entry->position),
+			token_label(&program->stream[entry->position]), (long long)entry->top);
+	}
+}
+
+#define trace_error(fs, program) (printf("\n"), trace_print(fs, program, stdout))
+
+#else
+
+#define trace_step(fs, step_position)
+#define trace_error(fs, program)
+
+#endif // FORTH_TRACE
+
+// ------------------------- PROFILER -------------------------
+
+// Sampling profiler of FORTH_PROFILER build: eval publish position and stack of called words in state,
+// SIGPROF timer handler count sample of state running on interrupted thread.
+
+#if defined(FORTH_PROFILER)
+
+#if defined(_WIN32)
+	#error "FORTH_PROFILER needs SIGPROF timer (POSIX)"
+#endif
+#include <signal.h>
+#include <sys/time.h>
+
+#define PROFILE_SAMPLES 4096 // different call chains, samples of new chains are dropped when table is full
+#define PROFILE_PROBES 64
+
+struct profile_sample {
+	const struct forth_byte_code* program;
+	int pc;
+	int depth;
+	int frames[FORTH_PROFILE_DEPTH];
+	const struct forth_byte_code* programs[FORTH_PROFILE_DEPTH]; // native can run other program, frames keep own
+	int count;
+};
+
+struct profile_running {
+	struct forth_state* fs;
+	const struct forth_byte_code* program;
+};
+
+static struct profile_sample profile_samples[PROFILE_SAMPLES];
+static forth_atomic_int profile_busy; // table is written by one handler at once
+static forth_atomic_int profile_dropped;
+static struct sigaction profile_old_action;
+static _Thread_local struct profile_running profile_running; // eval of this thread, read by signal handler
+
+// pc of eval nested in native of same state is restored, pc of caller is not position of other program
+#define profile_enter(fs, program, position) struct profile_running profile_previous = profile_running; int profile_pc_previous = (fs)->profile_pc;\
+	(fs)->profile_pc = (position); profile_running = (struct profile_running){ fs, program }
+#define profile_leave() (profile_running = profile_previous, fs->profile_pc = profile_pc_previous)
+#define profile_pc(fs, position) ((fs)->profile_pc = (position))
+
+// frames are name positions of called words, calls deeper than FORTH_PROFILE_DEPTH are counted only
+COMPONENT_PRIVATE void profile_call(struct forth_state* fs, const struct forth_byte_code* program, int position, bool tail_call) {
+	int depth = fs->profile_depth;
+	if (tail_call and depth > 0) {
+		depth--;
+	}
+	if (depth < FORTH_PROFILE_DEPTH) {
+		fs->profile_programs[depth] = program;
+		fs->profile_frames[depth] = position;
+	}
+	fs->profile_depth = depth + 1;
+}
+
+// top level run start without frames, run nested in native of same state keep frames of caller,
+// return depth to restore after nested run, -1 for top level
+COMPONENT_PRIVATE int profile_run_begin(struct forth_state* fs) {
+	if (profile_running.fs != fs) {
+		fs->profile_depth = 0;
+		return -1;
+	}
+	return fs->profile_depth;
+}
+
+COMPONENT_PRIVATE void profile_run_end(struct forth_state* fs, int depth) {
+	if (depth >= 0) {
+		fs->profile_depth = depth;
+	}
+}
+
+COMPONENT_PRIVATE void profile_return(struct forth_state* fs) {
+	if (fs->profile_depth > 0) {
+		fs->profile_depth--;
+	}
+}
+
+COMPONENT_PRIVATE bool profile_same(const struct profile_sample* sample, const struct profile_sample* key) {
+	if (sample->program != key->program or sample->pc != key->pc or sample->depth != key->depth) {
+		return false;
+	}
+	return memcmp(sample->frames, key->frames, key->depth * sizeof(key->frames[0])) == 0
+		and memcmp(sample->programs, key->programs, key->depth * sizeof(key->programs[0])) == 0;
+}
+
+COMPONENT_PRIVATE void profile_signal(int signal) {
+	struct profile_running running = profile_running;
+	if (running.fs == NULL) {
+		return; // host code
+	}
+	if (forth_atomic_fetch_add(&profile_busy, 1) != 0) {
+		forth_atomic_fetch_add(&profile_busy, -1);
+		forth_atomic_fetch_add(&profile_dropped, 1);
+		return;
+	}
+
+	struct profile_sample key = { .program = running.program, .pc = running.fs->profile_pc };
+	key.depth = running.fs->profile_depth < FORTH_PROFILE_DEPTH ? running.fs->profile_depth : FORTH_PROFILE_DEPTH;
+	uint32_t hash = 2166136261u ^ (uint32_t)key.pc; // FNV-1a of call chain
+	for (int frame = 0; frame < key.depth; frame++) {
+		key.frames[frame] = running.fs->profile_frames[frame];
+		key.programs[frame] = running.fs->profile_programs[frame];
+		hash = (hash ^ (uint32_t)key.frames[frame]) * 16777619u;
+	}
+
+	int probe = 0;
+	for (; probe < PROFILE_PROBES; probe++) {
+		struct profile_sample* sample = &profile_samples[(hash + probe) % PROFILE_SAMPLES];
+		if (sample->count == 0) {
+			*sample = key;
+			sample->count = 1;
+			break;
+		}
+		if (profile_same(sample, &key)) {
+			sample->count++;
+			break;
+		}
+	}
+	if (probe == PROFILE_PROBES) {
+		forth_atomic_fetch_add(&profile_dropped, 1);
+	}
+	forth_atomic_fetch_add(&profile_busy, -1);
+}
+
+#else
+
+#define profile_enter(fs, program, position)
+#define profile_leave() ((void)0)
+#define profile_pc(fs, position)
+#define profile_call(fs, program, position, tail_call) ((void)(program))
+#define profile_return(fs)
+#define profile_run_begin(fs) 0
+#define profile_run_end(fs, depth) ((void)(depth))
+
+#endif // FORTH_PROFILER
+
+// ------------------------- CONTROLL FLOW OPERATIONS -------------------------
+
+COMPONENT_PRIVATE int find_controll_flow_token(const struct token* stream, int position, enum token_type incriment, enum token_type find) {
+	int temp_position = position + 1;
+	int if_stack = 0;
+	while (true) {
+		enum token_type type = stream[temp_position].type;
+		if (type == incriment) {
+			if_stack++;
+		}
+
+		if (type == find) {
+			if (if_stack == 0) {
+				return temp_position;
+			} else {
+				if_stack--;
+			}
+		}
+
+		if (type == tt_semicolon) {
+			return -1;
+		}
+
+		temp_position++;
+	}
+}
+
+
+COMPONENT_PRIVATE int if_op(struct forth_state* fs, const struct token* stream, int position) {
+	forth_cell cmp = stack_pop(fs);
+
+	int find_else = find_controll_flow_token(stream, position, tt_if, tt_else);
+	int find_then = find_controll_flow_token(stream, position, tt_if, tt_then);
+
+	if (cmp == ftrue) {
+		if(find_else > 0){
+			return_stack_push(fs, find_then);
+		}
+		return position;
+	}
+
+	if (find_else > 0) {
+		return find_else;
+	} else {
+		return find_then;
+	}
+}
+
+COMPONENT_PRIVATE int dictionary_find(struct forth_state* fs, const char* name) {
+	for (int i = 0; i < fs->dictionary_count; i++) {
+		if (strcmp(fs->dictionary[i].name, name) == 0) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+// name defined again replace old definition, all callers find new one by name
+COMPONENT_PRIVATE void dictionary_add_from_name(struct forth_state* fs, const char* name, enum named_type type, forth_cell data) {
+	int index = dictionary_find(fs, name);
+	if (index < 0) {
+		index = fs->dictionary_count;
+		fs->dictionary_count++;
+	}
+	fs->dictionary[index] = (struct named_any){ .name = name, .data = data, .type = type };
+}
+
+COMPONENT_PRIVATE int dictionary_add_from_token(struct forth_state* fs, const struct token* stream, int position, enum named_type type, forth_cell data) {
+	const struct token name_token = stream[position + 1];
+	dictionary_add_from_name(fs, name_token.data.name, type, data);
+	if (type == nt_function) {
+		return find_controll_flow_token(stream, position, tt_none, tt_semicolon); // skip function body
+	} else {
+		return position + 1;
+	}
+}
+
+COMPONENT_PRIVATE bool dictionary_get_push(struct forth_state* fs, const char* name) {
+	int index = dictionary_find(fs, name);
+	if (index < 0) {
+		return false;
+	}
+	const struct named_any current = fs->dictionary[index];
+	stack_push(fs, current.data);
+	stack_push(fs, current.type);
+	return true;
+}
+
+COMPONENT_PRIVATE int variable_op(struct forth_state* fs, const struct token* stream, int position) {
+	int index = dictionary_find(fs, stream[position + 1].data.name);
+	if (index >= 0 and fs->dictionary[index].type == nt_variable) { // variable defined again, keep memory and value
+		return position + 1;
+	}
+	int pointer = fs->integer_memory_pointer_top;
+	if (pointer + 1 > fs->heap_bottom) {
+		printf("Error variable %s over heap or end of memory", stream[position + 1].data.name);
+		return position + 1;
+	}
+	fs->integer_memory_pointer_top++;
+	return dictionary_add_from_token(fs, stream, position, nt_variable, pointer);
+}
+
+// memory of variables and allot grows up to heap bottom
+COMPONENT_PRIVATE void allot_op(struct forth_state* fs) {
+	int offset = (int)stack_pop(fs);
+	if (offset > fs->heap_bottom - fs->integer_memory_pointer_top) {
+		printf("Error allot %d over heap or end of memory", offset);
+		return;
+	}
+	fs->integer_memory_pointer_top += offset;
+}
+
+COMPONENT_PRIVATE int do_loop_start(struct forth_state* fs, const struct token* stream, int position) { // TODO rewrite danger with push stack and next loop
+	forth_cell start_index = stack_pop(fs);
+	forth_cell end_index = stack_pop(fs);
+
+	if (start_index < end_index) {
+		return_stack_push(fs, position);
+		return_stack_push(fs, end_index);
+		return_stack_push(fs, start_index);
+		return position;
+	} else {
+		return find_controll_flow_token(stream, position, tt_do, tt_loop);
+	}
+}
+
+COMPONENT_PRIVATE int do_loop_end(struct forth_state* fs, const struct token* stream, int position) {
+	forth_cell start_index = return_stack_pop(fs);
+	forth_cell end_index = return_stack_pop(fs);
+	int do_position = (int)return_stack_pop(fs);
+
+	start_index++;
+
+	if (start_index < end_index) {
+		return_stack_push(fs, do_position);
+		return_stack_push(fs, end_index);
+		return_stack_push(fs, start_index);
+		return do_position;
+	} else {
+		return position;
+	}
+}
+
+COMPONENT_PRIVATE void loop_index_push(struct forth_state* fs) {
+	forth_cell i = return_stack_pop(fs);
+	stack_push(fs, i);
+	return_stack_push(fs, i);
+}
+
+COMPONENT_PRIVATE void set_value(struct forth_state* fs) {
+	forth_cell pointer = stack_pop(fs);
+	fs->integer_memory[pointer] = stack_pop(fs);
+}
+
+COMPONENT_PRIVATE void get_value_of_variable(struct forth_state* fs) { // at @
+	forth_cell pointer = stack_pop(fs);
+	stack_push(fs, fs->integer_memory[pointer]);
+}
+
+COMPONENT_PRIVATE int until_op(struct forth_state* fs, int current_pos) { // return jump position
+	forth_cell value = stack_pop(fs);
+	if (value == ftrue) {
+		return (int)return_stack_pop(fs);
+	} else {
+		return_stack_pop(fs);
+		return current_pos;
+	}
+}
+
+COMPONENT_PRIVATE int ident_op(struct forth_state* fs, const struct forth_byte_code* program, const char* name, int position, bool tail_call) {
+	if (not dictionary_get_push(fs, name)) { // push data and type to stack
+		printf("Error name constant/variable/function nor found, what is: %s ?", name);
+		return position;
+	}
+
+	// is type function jump to func body
+	int ident_type = (int)stack_pop(fs);
+	if (ident_type == (int)nt_function) {
+		if (not tail_call) { // tail call return with position of caller
+			return_stack_push(fs, position);
+		}
+		int function_position = (int)stack_pop(fs);
+		profile_call(fs, program, function_position, tail_call);
+		return function_position;
+	}
+
+	if (ident_type == (int)nt_function_native) {
+		int native_function_index = (int)stack_pop(fs);
+		fs->stats.native_calls++;
+		fs->native_functions[native_function_index](fs);
+	}
+	return position;
+}
+
+// watchdog flag is checked only before backward jumps and calls, state stay resumable from position
+COMPONENT_PRIVATE bool interrupt_pending(struct forth_state* fs, int position) {
+	if (not forth_atomic_load(&fs->interrupt)) {
+		return false;
+	}
+	forth_atomic_store(&fs->interrupt, 0);
+	fs->pc = position;
+	return true;
+}
+
+// native suspended vm, resume after call
+COMPONENT_PRIVATE bool native_suspended(struct forth_state* fs, int position) {
+	if (not fs->suspended) {
+		return false;
+	}
+	fs->pc = position + 1;
+	return true;
+}
+
+// count of eval is kept in local, state is updated once on exit
+COMPONENT_PRIVATE enum forth_status stats_flush(struct forth_state* fs, long long executed, enum forth_status status) {
+	fs->stats.instructions += executed;
+	return status;
+}
+
+#define eval_return(status) return profile_leave(), stats_flush(fs, executed, status)
+// native can run this program again, lazy bodies appended by nested run move and grow stream
+#define eval_reload() (stream = program->stream, end_poition = run_to_end ? program->count : end_poition)
+
+COMPONENT_PRIVATE enum forth_status eval(struct forth_state* fs, const struct forth_byte_code* program, int start_position, int end_poition) {
+	const struct token* stream = program->stream;
+	bool run_to_end = end_poition == program->count;
+	long long executed = 0;
+	profile_enter(fs, program, start_position);
+	for (int current_pos = start_position; current_pos < end_poition; current_pos++) {
+		const struct token current_token = stream[current_pos];
+		profile_pc(fs, current_pos);
+		executed++;
+		enum token_type current_token_type = current_token.type;
+		trace_step(fs, current_pos);
+
+		switch (current_token_type) {
+		case tt_dup:
+			dup_op(fs);
+			break;
+
+		case tt_drop:
+			drop_op(fs);
+			break;
+
+		case tt_swap:
+			swap_op(fs);
+			break;
+
+		case tt_over:
+			over_op(fs);
+			break;
+
+		case tt_rot:
+			rot_op(fs);
+			break;
+
+		case tt_dot:
+			dot_op(fs);
+			break;
+
+		case tt_emit:
+			break;
+
+		case tt_cr:
+			cr_op(fs);
+			break;
+
+		case tt_equal:
+			equal_op(fs);
+			break;
+
+		case tt_great:
+			great_op(fs);
+			break;
+
+		case tt_less:
+			less_op(fs);
+			break;
+
+		case tt_invert:
+			invert_op(fs);
+			break;
+
+		case tt_and:
+			and_op(fs);
+			break;
+
+		case tt_or:
+			or_op(fs);
+			break;
+
+		case tt_plus:
+			plus_op(fs);
+			break;
+
+		case tt_minus:
+			minus_op(fs);
+			break;
+
+		case tt_multip:
+			multiplication_op(fs);
+			break;
+
+		case tt_div:
+			dividing_op(fs);
+			break;
+
+		case tt_mod:
+			mod_op(fs);
+			break;
+
+		case tt_at:
+			get_value_of_variable(fs);
+			break;
+
+		case tt_setvalue:
+			set_value(fs);
+			break;
+
+		case tt_index:
+			loop_index_push(fs);
+			break;
+
+		case tt_allot:
+			allot_op(fs);
+			break;
+
+#if defined(FORTH_WORDS_BULK)
+		case tt_fill:
+			fill_op(fs);
+			break;
+
+		case tt_move:
+			move_op(fs);
+			break;
+
+		case tt_cmove:
+			cmove_op(fs);
+			break;
+
+		case tt_sum:
+			sum_op(fs);
+			break;
+
+		case tt_array_min:
+			array_min_op(fs);
+			break;
+
+		case tt_array_max:
+			array_max_op(fs);
+			break;
+
+		case tt_array_plus:
+			array_plus_op(fs);
+			break;
+
+		case tt_array_multip:
+			array_multip_op(fs);
+			break;
+
+		case tt_array_equal:
+			array_equal_op(fs);
+			break;
+
+		case tt_search:
+			search_op(fs);
+			break;
+#endif
+
+#if defined(FORTH_WORDS_HEAP)
+		case tt_allocate:
+			allocate_op(fs);
+			break;
+
+		case tt_free:
+			free_op(fs);
+			break;
+
+		case tt_resize:
+			resize_op(fs);
+			break;
+#endif
+
+#if defined(FORTH_WORDS_MESSAGE)
+		case tt_receive:
+			receive_op(fs);
+			break;
+
+		case tt_message_ready:
+			message_ready_op(fs);
+			break;
+#endif
+
+#if defined(FORTH_WORDS_FLOAT)
+		case tt_fplus:
+		case tt_fminus:
+		case tt_fmultip:
+		case tt_fdiv:
+		case tt_fless:
+		case tt_fequal:
+			float_math_op(fs, current_token_type);
+			break;
+
+		case tt_fdup: {
+			forth_float value = float_pop(fs);
+			float_push(fs, value);
+			float_push(fs, value);
+			break;
+		}
+
+		case tt_fdrop:
+			float_pop(fs);
+			break;
+
+		case tt_fswap:
+			fswap_op(fs);
+			break;
+
+		case tt_fat:
+			float_get_op(fs);
+			break;
+
+		case tt_fsetvalue:
+			float_set_op(fs);
+			break;
+
+		case tt_fdot:
+			float_dot_op(fs);
+			break;
+
+		case tt_int_to_float:
+			float_push(fs, (forth_float)stack_pop(fs));
+			break;
+
+		case tt_float_to_int:
+			stack_push(fs, (forth_cell)float_pop(fs));
+			break;
+
+		case tt_float_value:
+			float_push(fs, current_token.data.real);
+			break;
+#endif
+
+		case tt_begin:
+			return_stack_push(fs, current_pos - 1);
+			break;
+
+		case tt_value:
+			stack_push(fs, current_token.data.integer);
+			break;
+
+		case tt_dotstring:
+			do_string_op(current_token);
+			break;
+
+		case tt_if:
+			current_pos = if_op(fs, stream, current_pos);
+			break;
+
+		case tt_do:
+			current_pos = do_loop_start(fs, stream, current_pos);
+			break;
+
+		case tt_loop:
+			if (interrupt_pending(fs, current_pos))
+				eval_return(forth_interrupted);
+			current_pos = do_loop_end(fs, stream, current_pos); // jump to do token
+			break;
+
+		case tt_until:
+			if (interrupt_pending(fs, current_pos))
+				eval_return(forth_interrupted);
+			current_pos = until_op(fs, current_pos);
+			break;
+
+		case tt_constant:
+			current_pos = dictionary_add_from_token(fs, stream, current_pos, nt_constant, stack_pop(fs));
+			break;
+
+		case tt_variable:
+			current_pos = variable_op(fs, stream, current_pos);
+			break;
+
+		case tt_function:
+			current_pos = dictionary_add_from_token(fs, stream, current_pos, nt_function, current_pos + 1);// +1 skip token name
+			break;
+
+		case tt_ident:
+			if (interrupt_pending(fs, current_pos))
+				eval_return(forth_interrupted);
+			current_pos = ident_op(fs, program, current_token.data.name, current_pos, false);
+			eval_reload();
+			if (native_suspended(fs, current_pos))
+				eval_return(forth_pending);
+			break;
+
+		case tt_tail_call:
+			if (interrupt_pending(fs, current_pos))
+				eval_return(forth_interrupted);
+			current_pos = ident_op(fs, program, current_token.data.name, current_pos, true);
+			eval_reload();
+			if (native_suspended(fs, current_pos))
+				eval_return(forth_pending);
+			break;
+
+		case tt_recurse:
+			if (current_token.data.integer < 0) {
+				printf("Error recurse used outside of function");
+				break;
+			}
+			if (interrupt_pending(fs, current_pos))
+				eval_return(forth_interrupted);
+			return_stack_push(fs, current_pos);
+			current_pos = (int)current_token.data.integer; // jump to function name, next token is body
+			profile_call(fs, program, current_pos, false);
+			break;
+
+		case tt_tail_recurse:
+			if (interrupt_pending(fs, current_pos))
+				eval_return(forth_interrupted);
+			current_pos = (int)current_token.data.integer;
+			break;
+
+		case tt_jump:
+			current_pos = (int)current_token.data.integer;
+			break;
+
+		case tt_lazy_body:
+			if (not compile_lazy_body((struct forth_byte_code*)program, current_pos)) {
+				printf("Error compile body of function: %s", stream[current_pos - 1].data.name);
+				eval_return(forth_ok);
+			}
+			eval_reload(); // body appended, stream moved
+			current_pos = (int)stream[current_pos].data.integer;
+			break;
+
+		
+		case tt_else: // jump to then
+			current_pos = (int)return_stack_pop(fs);
+			break;
+
+		case tt_semicolon: // jump to call function position 
+			profile_return(fs);
+			current_pos = (int)return_stack_pop(fs);
+			if (current_pos == return_to_host) {
+				eval_return(forth_ok);
+			}
+			break;
+
+			// not used
+		case tt_then:
+		case tt_cells:
+		//case tt_string:
+		case tt_none:
+			break;
+
+		default:
+			printf("Undefine operator from token: %s", current_token.data.name);
+			trace_error(fs, program);
+			eval_return(forth_ok);
+		}
+	}
+	eval_return(forth_ok);
+}
+
+#undef eval_return
+#undef eval_reload
+
+// ------------------------- GUARDED MEMORY -------------------------
+
+// FORTH_GUARDED_STACKS build: stacks and integer memory are mapped between two no access pages, end of segment
+// touch guard page and system commit pages on first use. Overflow of running script fault on guard page,
+// signal handler jump back to guarded_eval and run stops with forth_error.
+
+#if defined(FORTH_GUARDED_STACKS)
+
+#if defined(_WIN32)
+	#error "FORTH_GUARDED_STACKS needs mmap and SIGSEGV (POSIX)"
+#endif
+#include <signal.h>
+#include <setjmp.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#if not defined(MAP_NORESERVE)
+#define MAP_NORESERVE 0
+#endif
+
+struct guard_running {
+	struct forth_state** states; // one state or lanes of batch
+	int count;
+	sigjmp_buf* jump;
+	int fault_index; // state of fault, set by signal handler
+	const char* fault_address;
+};
+
+static _Thread_local struct guard_running guard_running; // eval of this thread, read by signal handler
+static struct sigaction guard_old_action;
+static forth_atomic_int guard_installed;
+static size_t guard_page_size;
+
+COMPONENT_PRIVATE size_t guard_mapping_size(size_t bytes) {
+	return (bytes + guard_page_size - 1) / guard_page_size * guard_page_size + 2 * guard_page_size;
+}
+
+// segment has size of request, pages get memory on first touch and untouched pages are not reserved in swap,
+// so big sizes cost only used pages and segment never grows or moves
+COMPONENT_PRIVATE void* segment_alloc(int count, size_t size) {
+	size_t bytes = (size_t)count * size;
+	size_t mapping_size = guard_mapping_size(bytes);
+	char* mapping = mmap(NULL, mapping_size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	if (mapping == MAP_FAILED) {
+		return NULL;
+	}
+	if (mprotect(mapping + guard_page_size, mapping_size - 2 * guard_page_size, PROT_READ | PROT_WRITE) != 0) {
+		munmap(mapping, mapping_size);
+		return NULL;
+	}
+	return mapping + mapping_size - guard_page_size - bytes;
+}
+
+// mapping start of segment, guard pages included
+COMPONENT_PRIVATE char* segment_mapping(const void* segment, int count, size_t size) {
+	size_t bytes = (size_t)count * size;
+	return (char*)segment + bytes + guard_page_size - guard_mapping_size(bytes);
+}
+
+COMPONENT_PRIVATE void segment_free(void* segment, int count, size_t size) {
+	if (segment != NULL) {
+		munmap(segment_mapping(segment, count, size), guard_mapping_size((size_t)count * size));
+	}
+}
+
+COMPONENT_PRIVATE bool segment_contains(const void* segment, int count, size_t size, const char* address) {
+	const char* mapping = segment_mapping(segment, count, size);
+	return segment != NULL and address >= mapping and address < mapping + guard_mapping_size((size_t)count * size);
+}
+
+COMPONENT_PRIVATE bool state_contains(const struct forth_state* fs, const char* address) {
+	return segment_contains(fs->data_stack, fs->stats.data_stack_size, sizeof(*fs->data_stack), address)
+		or segment_contains(fs->float_stack, fs->stats.float_stack_size, sizeof(*fs->float_stack), address)
+		or segment_contains(fs->return_stack, fs->stats.return_stack_size, sizeof(*fs->return_stack), address)
+		or segment_contains(fs->integer_memory, fs->integer_memory_size, sizeof(*fs->integer_memory), address);
+}
+
+COMPONENT_PRIVATE void guard_signal(int signal, siginfo_t* info, void* context) {
+	const char* address = info->si_addr;
+	for (int index = 0; index < guard_running.count; index++) {
+		if (state_contains(guard_running.states[index], address)) {
+			guard_running.fault_index = index;
+			guard_running.fault_address = address;
+			siglongjmp(*guard_running.jump, 1);
+		}
+	}
+	sigaction(SIGSEGV, &guard_old_action, NULL); // not fault of script, fault again with old handler
+}
+
+COMPONENT_PRIVATE void guard_install() {
+	if (forth_atomic_fetch_add(&guard_installed, 1) != 0) {
+		return;
+	}
+	guard_page_size = (size_t)sysconf(_SC_PAGESIZE);
+	struct sigaction action = { 0 };
+	action.sa_sigaction = guard_signal;
+	action.sa_flags = SA_SIGINFO;
+	sigemptyset(&action.sa_mask);
+	sigaction(SIGSEGV, &action, &guard_old_action);
+}
+
+// stacks of failed run are cleared, memory and dictionary are kept
+COMPONENT_PRIVATE enum forth_status guard_fail(struct forth_state* fs, const struct forth_byte_code* program) {
+	fs->data_stack_top = 0;
+	fs->float_stack_top = 0;
+	fs->return_stack_top = 0;
+	printf("Error stack or memory out of range");
+	trace_error(fs, program);
+	return forth_error;
+}
+
+COMPONENT_PRIVATE enum forth_status guarded_eval(struct forth_state* fs, const struct forth_byte_code* program, int start_position, int end_position) {
+	sigjmp_buf jump;
+	struct guard_running previous = guard_running;
+	if (sigsetjmp(jump, 1) != 0) {
+		guard_running = previous;
+#if defined(FORTH_PROFILER)
+		profile_running = (struct profile_running){ 0 };
+#endif
+		return guard_fail(fs, program);
+	}
+	guard_running = (struct guard_running){ .states = &fs, .count = 1, .jump = &jump };
+	enum forth_status status = eval(fs, program, start_position, end_position);
+	guard_running = previous;
+	return status;
+}
+
+#else
+
+#define guard_install()
+#define segment_alloc(count, size) calloc(count, size)
+#define segment_free(segment, count, size) free(segment)
+#define guarded_eval(fs, program, start_position, end_position) eval(fs, program, start_position, end_position)
+
+#endif // FORTH_GUARDED_STACKS
+
+// ------------------------- BATCH EVAL -------------------------
+
+// One program runs for a group of states in lockstep. Data stacks of the group are kept as rows of lanes
+// (structure of arrays), one row is one stack cell of every state, stack and math words work on whole rows.
+// Control flow is shared while every lane takes the same branch, return stack of first state is used for all.
+// On divergent branch (or too deep stack) every state continues alone with eval.
+
+#define FORTH_BATCH_LANES 8
+#define FORTH_BATCH_DEPTH 32
+
+typedef void (*lane_kernel)(forth_cell* result, const forth_cell* value2, const forth_cell* value1); // result may be value2 row
+
+struct lane_kernels {
+	lane_kernel plus;
+	lane_kernel minus;
+	lane_kernel multip;
+	lane_kernel equal;
+	lane_kernel great;
+	lane_kernel less;
+	lane_kernel logic_and;
+	lane_kernel logic_or;
+};
+
+#define make_lane_kernel(name, expression) COMPONENT_PRIVATE void lane_##name##_scalar(forth_cell* result, const forth_cell* value2, const forth_cell* value1) {\
+	for (int lane = 0; lane < FORTH_BATCH_LANES; lane++) {\
+		forth_ucell a = (forth_ucell)value1[lane];\
+		forth_ucell b = (forth_ucell)value2[lane];\
+		result[lane] = (forth_cell)(expression);\
+	}\
+}
+
+make_lane_kernel(plus, b + a)
+make_lane_kernel(minus, b - a)
+make_lane_kernel(multip, b * a)
+make_lane_kernel(equal, b == a ? ftrue : ffalse)
+make_lane_kernel(great, (forth_cell)b > (forth_cell)a ? ftrue : ffalse)
+make_lane_kernel(less, (forth_cell)b < (forth_cell)a ? ftrue : ffalse)
+make_lane_kernel(logic_and, (forth_cell)a == ftrue and (forth_cell)b == ftrue ? ftrue : ffalse)
+make_lane_kernel(logic_or, (forth_cell)a == ftrue or (forth_cell)b == ftrue ? ftrue : ffalse)
+
+static const struct lane_kernels lane_kernels_scalar = {
+	lane_plus_scalar, lane_minus_scalar, lane_multip_scalar, lane_equal_scalar,
+	lane_great_scalar, lane_less_scalar, lane_logic_and_scalar, lane_logic_or_scalar
+};
+
+#ifdef FORTH_AVX2
+#define make_lane_kernel_avx2(name, expression) FORTH_TARGET_AVX2 COMPONENT_PRIVATE void lane_##name##_avx2(forth_cell* result, const forth_cell* value2, const forth_cell* value1) {\
+	__m256i a = _mm256_loadu_si256((const __m256i*)value1);\
+	__m256i b = _mm256_loadu_si256((const __m256i*)value2);\
+	__m256i true_lanes = _mm256_set1_epi32(ftrue);\
+	(void)true_lanes;\
+	_mm256_storeu_si256((__m256i*)result, expression);\
+}
+
+make_lane_kernel_avx2(plus, _mm256_add_epi32(b, a))
+make_lane_kernel_avx2(minus, _mm256_sub_epi32(b, a))
+make_lane_kernel_avx2(multip, _mm256_mullo_epi32(b, a))
+make_lane_kernel_avx2(equal, _mm256_cmpeq_epi32(b, a))
+make_lane_kernel_avx2(great, _mm256_cmpgt_epi32(b, a))
+make_lane_kernel_avx2(less, _mm256_cmpgt_epi32(a, b))
+make_lane_kernel_avx2(logic_and, _mm256_and_si256(_mm256_cmpeq_epi32(a, true_lanes), _mm256_cmpeq_epi32(b, true_lanes)))
+make_lane_kernel_avx2(logic_or, _mm256_or_si256(_mm256_cmpeq_epi32(a, true_lanes), _mm256_cmpeq_epi32(b, true_lanes)))
+
+static const struct lane_kernels lane_kernels_avx2 = {
+	lane_plus_avx2, lane_minus_avx2, lane_multip_avx2, lane_equal_avx2,
+	lane_great_avx2, lane_less_avx2, lane_logic_and_avx2, lane_logic_or_avx2
+};
+#endif // FORTH_AVX2
+
+// lane kernels follow level of bulk kernels
+COMPONENT_PRIVATE const struct lane_kernels* lanes() {
+#ifdef FORTH_AVX2
+	if (bulk() == &bulk_kernels_avx2)
+		return &lane_kernels_avx2;
+#endif
+	return &lane_kernels_scalar;
+}
+
+struct batch {
+	struct forth_state** states;
+	int lanes;
+	int depth;
+	bool loaded; // data stacks are in rows, stacks of states are empty
+	long long executed; // tokens run in lockstep, counted for every state
+	int data_max, return_max; // depth of rows and shared return stack, sampled where they grow
+	volatile int position; // token of lockstep, lanes continue alone from it after fault of one lane
+	forth_cell rows[FORTH_BATCH_DEPTH][FORTH_BATCH_LANES];
+};
+
+// lockstep share return stack of first state and runs float words for every state alone,
+// state must start with empty return and float stacks
+COMPONENT_PRIVATE bool batch_accept(const struct forth_state* fs) {
+	if (fs->return_stack_top != 0 or fs->float_stack_top != 0) {
+		printf("Error batch state has values on return or float stack");
+		return false;
+	}
+	return true;
+}
+
+// move data stacks of states to rows, false if depth is not same for all states
+COMPONENT_PRIVATE bool batch_load(struct batch* b) {
+	int depth = b->states[0]->data_stack_top;
+	if (depth > FORTH_BATCH_DEPTH) {
+		return false;
+	}
+	for (int lane = 1; lane < b->lanes; lane++) {
+		if (b->states[lane]->data_stack_top != depth) {
+			return false;
+		}
+	}
+
+	memset(b->rows, 0, sizeof(b->rows)); // unused lanes must be defined for kernels
+	for (int lane = 0; lane < b->lanes; lane++) {
+		struct forth_state* fs = b->states[lane];
+		for (int row = 0; row < depth; row++) {
+			b->rows[row][lane] = fs->data_stack[row];
+		}
+		fs->data_stack_top = 0;
+	}
+	b->depth = depth;
+	b->data_max = depth > b->data_max ? depth : b->data_max;
+	b->loaded = true;
+	return true;
+}
+
+COMPONENT_PRIVATE void batch_store(struct batch* b) {
+	for (int lane = 0; lane < b->lanes; lane++) {
+		struct forth_state* fs = b->states[lane];
+		for (int row = 0; row < b->depth; row++) {
+			fs->data_stack[row] = b->rows[row][lane];
+		}
+		fs->data_stack_top = b->depth;
+	}
+	b->loaded = false;
+}
+
+// add counters of lockstep to stats of every state, counters start again
+COMPONENT_PRIVATE void batch_count(struct batch* b) {
+	for (int lane = 0; lane < b->lanes; lane++) {
+		struct forth_stats* stats = &b->states[lane]->stats;
+		stats->instructions += b->executed;
+		stats->data_stack_max = b->data_max > stats->data_stack_max ? b->data_max : stats->data_stack_max;
+		stats->return_stack_max = b->return_max > stats->return_stack_max ? b->return_max : stats->return_stack_max;
+	}
+	b->executed = 0;
+}
+
+// give every state own copy of shared return stack, return position to continue alone
+COMPONENT_PRIVATE int batch_leave(struct batch* b, int position) {
+	if (b->loaded) {
+		batch_store(b);
+	}
+	const struct forth_state* control = b->states[0];
+	batch_count(b);
+	for (int lane = 1; lane < b->lanes; lane++) {
+		struct forth_state* fs = b->states[lane];
+		memcpy(fs->return_stack, control->return_stack, control->return_stack_top * sizeof(*fs->return_stack));
+		fs->return_stack_top = control->return_stack_top;
+	}
+	return position;
+}
+
+// stack have pop rows and place for push rows
+COMPONENT_PRIVATE bool batch_has(const struct batch* b, int pop, int push) {
+	return b->depth >= pop and b->depth - pop + push <= FORTH_BATCH_DEPTH;
+}
+
+// count pushed row, depth maximums are sampled where rows or shared return stack grow
+COMPONENT_PRIVATE void batch_grow(struct batch* b) {
+	b->depth++;
+	b->data_max = b->depth > b->data_max ? b->depth : b->data_max;
+}
+
+COMPONENT_PRIVATE void batch_return_grow(struct batch* b) {
+	int top = b->states[0]->return_stack_top;
+	b->return_max = top > b->return_max ? top : b->return_max;
+}
+
+// index 0 is top of stack
+COMPONENT_PRIVATE forth_cell* batch_row(struct batch* b, int index) {
+	return b->rows[b->depth - 1 - index];
+}
+
+COMPONENT_PRIVATE bool batch_uniform(const struct batch* b, const forth_cell* row) {
+	for (int lane = 1; lane < b->lanes; lane++) {
+		if (row[lane] != row[0]) {
+			return false;
+		}
+	}
+	return true;
+}
+
+COMPONENT_PRIVATE void batch_broadcast(struct batch* b, forth_cell value) {
+	forth_cell* row = b->rows[b->depth];
+	for (int lane = 0; lane < FORTH_BATCH_LANES; lane++) {
+		row[lane] = value;
+	}
+	batch_grow(b);
+}
+
+COMPONENT_PRIVATE void batch_binary(struct batch* b, lane_kernel kernel) {
+	kernel(batch_row(b, 1), batch_row(b, 1), batch_row(b, 0));
+	b->depth--;
+}
+
+// push uniform top rows to data stack of first state for scalar control flow operations
+COMPONENT_PRIVATE void batch_to_control(struct batch* b, int count) {
+	for (int index = count - 1; index >= 0; index--) {
+		stack_push(b->states[0], batch_row(b, index)[0]);
+	}
+	b->depth -= count;
+}
+
+// push data of name for every lane, false if name is missed or lanes do not agree on type or function body
+COMPONENT_PRIVATE bool batch_lookup(struct batch* b, const char* name, enum named_type* type) {
+	forth_cell* row = b->rows[b->depth];
+	for (int lane = 0; lane < b->lanes; lane++) {
+		struct forth_state* fs = b->states[lane];
+		int index = dictionary_find(fs, name);
+		if (index < 0) {
+			return false;
+		}
+		const struct named_any named = fs->dictionary[index];
+		if (lane == 0) {
+			*type = named.type;
+		} else if (named.type != *type or (named.type == nt_function and named.data != row[0])) {
+			return false;
+		}
+		row[lane] = named.data;
+	}
+	batch_grow(b);
+	return true;
+}
+
+// words with memory or host side effects run for every state with own stack, eval of state count the token,
+// false if lanes can not continue in lockstep (lane failed or was interrupted)
+COMPONENT_PRIVATE bool batch_each_state(struct batch* b, const struct forth_byte_code* program, int position) {
+	batch_store(b);
+	bool stopped = false;
+	for (int lane = 0; lane < b->lanes; lane++) {
+		struct forth_state* fs = b->states[lane];
+		fs->status = guarded_eval(fs, program, position, position + 1);
+		stopped = stopped or fs->status == forth_error or fs->status == forth_interrupted;
+	}
+	if (stopped or not batch_load(b)) {
+		return false;
+	}
+	b->executed--; // lockstep continue and count the token again
+	return true;
+}
+
+// interrupted lanes stop in eval at same position
+COMPONENT_PRIVATE bool batch_interrupt_pending(const struct batch* b) {
+	for (int lane = 0; lane < b->lanes; lane++) {
+		if (forth_atomic_load(&b->states[lane]->interrupt)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+COMPONENT_PRIVATE bool batch_suspended(const struct batch* b) {
+	for (int lane = 0; lane < b->lanes; lane++) {
+		if (b->states[lane]->suspended) {
+			return true;
+		}
+	}
+	return false;
+}
+
+// return position where lockstep stopped, program->count if program is done
+COMPONENT_PRIVATE int batch_eval(struct batch* b, const struct forth_byte_code* program) {
+	struct forth_state* control = b->states[0];
+	const struct lane_kernels* kernels = lanes();
+	const lane_kernel binary[tt_none] = {
+		[tt_plus] = kernels->plus, [tt_minus] = kernels->minus, [tt_multip] = kernels->multip,
+		[tt_equal] = kernels->equal, [tt_great] = kernels->great, [tt_less] = kernels->less,
+		[tt_and] = kernels->logic_and, [tt_or] = kernels->logic_or,
+	};
+	const struct token* stream = program->stream;
+
+	for (int current_pos = 0; current_pos < program->count; current_pos++, b->executed++) {
+		const struct token current_token = stream[current_pos];
+		b->position = current_pos;
+
+		switch (current_token.type) {
+		case tt_dup:
+			if (not batch_has(b, 1, 2))
+				return batch_leave(b, current_pos);
+			memcpy(b->rows[b->depth], batch_row(b, 0), sizeof(b->rows[0]));
+			batch_grow(b);
+			break;
+
+		case tt_drop:
+			if (not batch_has(b, 1, 0))
+				return batch_leave(b, current_pos);
+			b->depth--;
+			break;
+
+		case tt_swap: {
+			if (not batch_has(b, 2, 2))
+				return batch_leave(b, current_pos);
+			forth_cell temp[FORTH_BATCH_LANES];
+			memcpy(temp, batch_row(b, 0), sizeof(temp));
+			memcpy(batch_row(b, 0), batch_row(b, 1), sizeof(temp));
+			memcpy(batch_row(b, 1), temp, sizeof(temp));
+			break;
+		}
+
+		case tt_over:
+			if (not batch_has(b, 2, 3))
+				return batch_leave(b, current_pos);
+			memcpy(b->rows[b->depth], batch_row(b, 1), sizeof(b->rows[0]));
+			batch_grow(b);
+			break;
+
+		case tt_rot: {
+			if (not batch_has(b, 3, 3))
+				return batch_leave(b, current_pos);
+			forth_cell temp[FORTH_BATCH_LANES];
+			memcpy(temp, batch_row(b, 2), sizeof(temp));
+			memmove(batch_row(b, 1), batch_row(b, 2), 2 * sizeof(temp)); // rows 1 and 0 go one down
+			memcpy(batch_row(b, 0), temp, sizeof(temp));
+			break;
+		}
+
+		case tt_plus:
+		case tt_minus:
+		case tt_multip:
+		case tt_equal:
+		case tt_great:
+		case tt_less:
+		case tt_and:
+		case tt_or: {
+			if (not batch_has(b, 2, 1))
+				return batch_leave(b, current_pos);
+			batch_binary(b, binary[current_token.type]);
 			break;
+		}
 
-		case tt_dot:
-			dot_op(fs);
+		case tt_div:
+		case tt_mod: {
+			if (not batch_has(b, 2, 1))
+				return batch_leave(b, current_pos);
+			forth_cell* value1 = batch_row(b, 0);
+			forth_cell* value2 = batch_row(b, 1);
+			for (int lane = 0; lane < b->lanes; lane++) { // no simd integer division, unused lanes can be zero
+				value2[lane] = current_token.type == tt_div ? value2[lane] / value1[lane] : value2[lane] % value1[lane];
+			}
+			b->depth--;
 			break;
+		}
 
-		case tt_emit:
+		case tt_invert: {
+			if (not batch_has(b, 1, 1))
+				return batch_leave(b, current_pos);
+			forth_cell* value = batch_row(b, 0);
+			for (int lane = 0; lane < FORTH_BATCH_LANES; lane++) {
+				value[lane] = ~value[lane];
+			}
 			break;
+		}
 
-		case tt_cr:
-			cr_op(fs);
+		case tt_value:
+			if (not batch_has(b, 0, 1))
+				return batch_leave(b, current_pos);
+			batch_broadcast(b, current_token.data.integer);
 			break;
 
-		case tt_equal:
-			equal_op(fs);
+		case tt_at: { // gather from memory of every state
+			if (not batch_has(b, 1, 1))
+				return batch_leave(b, current_pos);
+			forth_cell* pointer = batch_row(b, 0);
+			forth_cell value[FORTH_BATCH_LANES]; // row is kept if read of lane fault
+			for (int lane = 0; lane < b->lanes; lane++) {
+				value[lane] = b->states[lane]->integer_memory[pointer[lane]];
+			}
+			memcpy(pointer, value, b->lanes * sizeof(*value));
 			break;
+		}
 
-		case tt_great:
-			great_op(fs);
+		case tt_setvalue: {
+			if (not batch_has(b, 2, 0))
+				return batch_leave(b, current_pos);
+			const forth_cell* pointer = batch_row(b, 0);
+			const forth_cell* value = batch_row(b, 1);
+			for (int lane = 0; lane < b->lanes; lane++) {
+				b->states[lane]->integer_memory[pointer[lane]] = value[lane];
+			}
+			b->depth -= 2;
 			break;
+		}
 
-		case tt_less:
-			less_op(fs);
+		case tt_index:
+			if (not batch_has(b, 0, 1))
+				return batch_leave(b, current_pos);
+			loop_index_push(control);
+			batch_broadcast(b, stack_pop(control));
+			break;
+
+		case tt_begin:
+			return_stack_push(control, current_pos - 1);
+			batch_return_grow(b);
+			break;
+
+		case tt_if:
+			if (not batch_has(b, 1, 0) or not batch_uniform(b, batch_row(b, 0)))
+				return batch_leave(b, current_pos);
+			batch_to_control(b, 1);
+			current_pos = if_op(control, stream, current_pos);
+			break;
+
+		case tt_until:
+			if (not batch_has(b, 1, 0) or not batch_uniform(b, batch_row(b, 0)) or batch_interrupt_pending(b))
+				return batch_leave(b, current_pos);
+			batch_to_control(b, 1);
+			current_pos = until_op(control, current_pos);
+			break;
+
+		case tt_do:
+			if (not batch_has(b, 2, 0) or not batch_uniform(b, batch_row(b, 0)) or not batch_uniform(b, batch_row(b, 1)))
+				return batch_leave(b, current_pos);
+			batch_to_control(b, 2);
+			current_pos = do_loop_start(control, stream, current_pos);
+			batch_return_grow(b);
+			break;
+
+		case tt_loop:
+			if (batch_interrupt_pending(b))
+				return batch_leave(b, current_pos);
+			current_pos = do_loop_end(control, stream, current_pos);
+			break;
+
+		case tt_else:
+			current_pos = (int)return_stack_pop(control);
+			break;
+
+		case tt_semicolon:
+			current_pos = (int)return_stack_pop(control);
+			if (current_pos == return_to_host) {
+				return batch_leave(b, program->count);
+			}
+			break;
+
+		case tt_recurse:
+			if (current_token.data.integer < 0 or batch_interrupt_pending(b))
+				return batch_leave(b, current_pos); // eval report error or stop
+			return_stack_push(control, current_pos);
+			batch_return_grow(b);
+			current_pos = (int)current_token.data.integer;
+			break;
+
+		case tt_tail_recurse:
+			if (batch_interrupt_pending(b))
+				return batch_leave(b, current_pos);
+			current_pos = (int)current_token.data.integer;
+			break;
+
+		case tt_jump:
+			current_pos = (int)current_token.data.integer;
+			break;
+
+		case tt_lazy_body:
+			if (not compile_lazy_body((struct forth_byte_code*)program, current_pos))
+				return batch_leave(b, current_pos); // eval report error
+			stream = program->stream;
+			current_pos = (int)stream[current_pos].data.integer;
+			break;
+
+		case tt_ident:
+		case tt_tail_call: {
+			enum named_type type;
+			if (batch_interrupt_pending(b) or not batch_has(b, 0, 1) or not batch_lookup(b, current_token.data.name, &type))
+				return batch_leave(b, current_pos);
+			if (type == nt_function) {
+				if (current_token.type == tt_ident) {
+					return_stack_push(control, current_pos);
+					batch_return_grow(b);
+				}
+				current_pos = (int)batch_row(b, 0)[0];
+				b->depth--;
+			} else if (type == nt_function_native) {
+				b->depth--;
+				bool lockstep = batch_each_state(b, program, current_pos);
+				stream = program->stream; // native can run this program again and move stream
+				if (not lockstep or batch_suspended(b))
+					return batch_leave(b, current_pos + 1);
+			}
+			break;
+		}
+
+		case tt_constant:
+			if (not batch_has(b, 1, 0))
+				return batch_leave(b, current_pos);
+			for (int lane = 0; lane < b->lanes; lane++) {
+				dictionary_add_from_token(b->states[lane], stream, current_pos, nt_constant, batch_row(b, 0)[lane]);
+			}
+			b->depth--;
+			current_pos++; // skip name
+			break;
+
+		case tt_variable:
+			for (int lane = 0; lane < b->lanes; lane++) {
+				variable_op(b->states[lane], stream, current_pos);
+			}
+			current_pos++;
+			break;
+
+		case tt_function: {
+			int body_end = current_pos;
+			for (int lane = 0; lane < b->lanes; lane++) {
+				body_end = dictionary_add_from_token(b->states[lane], stream, current_pos, nt_function, current_pos + 1);
+			}
+			current_pos = body_end;
+			break;
+		}
+
+		case tt_then:
+		case tt_cells:
+		case tt_none:
+			break;
+
+		default: // print, allot and bulk memory words
+			if (not batch_each_state(b, program, current_pos))
+				return batch_leave(b, current_pos + 1);
+			break;
+		}
+	}
+	return batch_leave(b, program->count);
+}
+
+#if defined(FORTH_GUARDED_STACKS)
+// fault on return stack of control state is shared by all lanes and stops all of them,
+// fault in memory of one lane stops that lane, other lanes continue alone from faulted token
+COMPONENT_PRIVATE int guarded_batch_eval(struct batch* b, const struct forth_byte_code* program) {
+	sigjmp_buf jump;
+	struct guard_running previous = guard_running;
+	if (sigsetjmp(jump, 1) != 0) {
+		struct guard_running fault = guard_running;
+		guard_running = previous;
+#if defined(FORTH_PROFILER)
+		profile_running = (struct profile_running){ 0 };
+#endif
+		const struct forth_state* control = b->states[0];
+		bool shared = segment_contains(control->return_stack, control->stats.return_stack_size, sizeof(*control->return_stack), fault.fault_address);
+		if (shared) {
+			batch_count(b);
+		}
+		int position = shared ? program->count : batch_leave(b, b->position);
+		for (int lane = 0; lane < b->lanes; lane++) {
+			if (shared or lane == fault.fault_index) {
+				b->states[lane]->status = guard_fail(b->states[lane], program);
+			}
+		}
+		return position;
+	}
+	guard_running = (struct guard_running){ .states = b->states, .count = b->lanes, .jump = &jump };
+	int position = batch_eval(b, program);
+	guard_running = previous;
+	return position;
+}
+#else
+#define guarded_batch_eval(b, program) batch_eval(b, program)
+#endif
+
+// ------------------------- OPTIMIZER -------------------------
+
+// Optimization passes rewrite the token stream before run. Jump positions are found at runtime,
+// so tokens can be removed or replaced while the if/else/then, do/loop and begin/until structure stays the same.
+
+#define FORTH_INLINE_MAX_TOKENS 8
+#define FORTH_OPTIMIZE_MAX_ROUNDS 8
+
+COMPONENT_PRIVATE void erase_token(struct token* current_token) {
+	release_token(*current_token);
+	current_token->type = tt_none;
+}
+
+COMPONENT_PRIVATE void compact_byte_code(struct forth_byte_code* fbc) { // remove erased tokens
+	int out = 0;
+	for (int in = 0; in < fbc->count; in++) {
+		if (fbc->stream[in].type != tt_none)
+			fbc->stream[out++] = fbc->stream[in];
+	}
+	fbc->count = out;
+}
+
+COMPONENT_PRIVATE bool is_definition_name(const struct token* stream, int position) { // name after : constant variable
+	if (position == 0)
+		return false;
+	enum token_type type = stream[position - 1].type;
+	return type == tt_function or type == tt_constant or type == tt_variable;
+}
+
+COMPONENT_PRIVATE int definitions_count(const struct forth_byte_code* fbc, const char* name) {
+	int count = 0;
+	for (int i = 1; i < fbc->count; i++) {
+		if (is_definition_name(fbc->stream, i) and fbc->stream[i].type == tt_ident and strcmp(fbc->stream[i].data.name, name) == 0)
+			count++;
+	}
+	return count;
+}
+
+COMPONENT_PRIVATE int fold_inputs(const struct token* stream, int position) { // literal inputs of pure operator, 0 if not foldable
+	switch (stream[position].type) {
+	case tt_dup:
+	case tt_drop:
+	case tt_invert:
+		return 1;
+
+	case tt_div:
+	case tt_mod: { // keep runtime behavior of bad divisors
+		forth_cell divisor = stream[position - 1].data.integer;
+		return divisor == 0 or divisor == -1 ? 0 : 2;
+	}
+
+	case tt_swap:
+	case tt_over:
+	case tt_equal:
+	case tt_great:
+	case tt_less:
+	case tt_and:
+	case tt_or:
+	case tt_plus:
+	case tt_minus:
+	case tt_multip:
+		return 2;
+
+	case tt_rot:
+		return 3;
+
+	default:
+		return 0;
+	}
+}
+
+// 2 3 + -> 5, operator executed by eval on scratch stack
+COMPONENT_PRIVATE bool optimize_fold(struct forth_byte_code* fbc) {
+	bool changed = false;
+	int out = 0;
+	for (int in = 0; in < fbc->count; in++) {
+		fbc->stream[out] = fbc->stream[in];
+
+		int literals = 0;
+		while (literals < 3 and literals < out and fbc->stream[out - literals - 1].type == tt_value)
+			literals++;
+
+		int inputs = literals > 0 ? fold_inputs(fbc->stream, out) : 0;
+		if (inputs == 0 or inputs > literals) {
+			out++;
+			continue;
+		}
+
+		forth_cell cells[4];
+		struct forth_state scratch = { .data_stack = cells };
+		for (int i = out - inputs; i < out; i++)
+			stack_push(&scratch, fbc->stream[i].data.integer);
+		eval(&scratch, fbc, out, out + 1);
+
+		out -= inputs; // every pure operator push not more than inputs + 1 values
+		for (int i = 0; i < scratch.data_stack_top; i++)
+			fbc->stream[out++] = (struct token){ .type = tt_value, .data.integer = cells[i] };
+		changed = true;
+	}
+	fbc->count = out;
+	return changed;
+}
+
+// 5 constant five ... five -> 5, only for top level constant defined once in script
+COMPONENT_PRIVATE bool optimize_constants(struct forth_byte_code* fbc) {
+	bool changed = false;
+	bool in_function = false;
+	int depth = 0;
+	for (int position = 0; position < fbc->count; position++) {
+		switch (fbc->stream[position].type) {
+		case tt_function: in_function = true; break;
+		case tt_semicolon: in_function = false; break;
+		case tt_if: case tt_do: case tt_begin: depth++; break;
+		case tt_then: case tt_loop: case tt_until: depth--; break;
+		default: break;
+		}
+
+		if (fbc->stream[position].type != tt_constant or in_function or depth != 0)
+			continue;
+		if (position == 0 or position + 1 >= fbc->count or fbc->stream[position - 1].type != tt_value or fbc->stream[position + 1].type != tt_ident)
+			continue;
+
+		const char* name = fbc->stream[position + 1].data.name;
+		if (definitions_count(fbc, name) != 1)
+			continue;
+
+		forth_cell value = fbc->stream[position - 1].data.integer;
+		for (int i = 0; i < fbc->count; i++) {
+			struct token* current_token = &fbc->stream[i];
+			if (current_token->type != tt_ident or i == position + 1 or strcmp(current_token->data.name, name) != 0)
+				continue;
+			release_token(*current_token);
+			*current_token = (struct token){ .type = tt_value, .data.integer = value };
+			changed = true;
+		}
+	}
+	return changed;
+}
+
+COMPONENT_PRIVATE bool match_if(const struct forth_byte_code* fbc, int if_position, int* else_position, int* then_position) {
+	int depth = 0;
+	*else_position = -1;
+	for (int position = if_position + 1; position < fbc->count; position++) {
+		switch (fbc->stream[position].type) {
+		case tt_if:
+			depth++;
+			break;
+
+		case tt_else:
+			if (depth == 0)
+				*else_position = position;
+			break;
+
+		case tt_then:
+			if (depth == 0) {
+				*then_position = position;
+				return true;
+			}
+			depth--;
+			break;
+
+		case tt_function:
+		case tt_semicolon:
+		case tt_none:
+			return false;
+
+		default:
+			break;
+		}
+	}
+	return false;
+}
+
+// -1 if A else B then -> A, 0 if A else B then -> B
+COMPONENT_PRIVATE bool optimize_branches(struct forth_byte_code* fbc) {
+	bool changed = false;
+	for (int position = 1; position < fbc->count; position++) {
+		if (fbc->stream[position].type != tt_if or fbc->stream[position - 1].type != tt_value)
+			continue;
+
+		int else_position, then_position;
+		if (not match_if(fbc, position, &else_position, &then_position))
+			continue;
+
+		int erase_from, erase_to; // erase range of not taken branch
+		if (fbc->stream[position - 1].data.integer == ftrue) {
+			erase_from = else_position > 0 ? else_position : then_position;
+			erase_to = then_position;
+		} else {
+			erase_from = position;
+			erase_to = else_position > 0 ? else_position : then_position;
+			erase_token(&fbc->stream[then_position]);
+		}
+
+		erase_token(&fbc->stream[position - 1]);
+		erase_token(&fbc->stream[position]);
+		for (int i = erase_from; i <= erase_to; i++)
+			erase_token(&fbc->stream[i]);
+		changed = true;
+	}
+	compact_byte_code(fbc);
+	return changed;
+}
+
+COMPONENT_PRIVATE bool inline_token_allowed(enum token_type type) {
+	switch (type) {
+	case tt_index: // reads loop counter from return stack, position of call matters
+	case tt_if:
+	case tt_else:
+	case tt_then:
+	case tt_do:
+	case tt_loop:
+	case tt_begin:
+	case tt_until:
+	case tt_recurse:
+	case tt_lazy_body:
+	case tt_constant:
+	case tt_variable:
+	case tt_function:
+	case tt_semicolon:
+	case tt_none:
+		return false;
+	default:
+		return true;
+	}
+}
+
+// return body length of small not recursive word defined once at position, -1 if word can not be inlined
+COMPONENT_PRIVATE int inline_body_size(const struct forth_byte_code* fbc, int position) {
+	if (position + 1 >= fbc->count or fbc->stream[position + 1].type != tt_ident)
+		return -1;
+
+	const char* name = fbc->stream[position + 1].data.name;
+	for (int i = position + 2; i < fbc->count and i <= position + 2 + FORTH_INLINE_MAX_TOKENS; i++) {
+		const struct token current_token = fbc->stream[i];
+		if (current_token.type == tt_semicolon)
+			return definitions_count(fbc, name) == 1 ? i - position - 2 : -1;
+		if (not inline_token_allowed(current_token.type))
+			return -1;
+		if (current_token.type == tt_ident and strcmp(current_token.data.name, name) == 0)
+			return -1;
+	}
+	return -1;
+}
+
+// : sq dup * ; 3 sq -> 3 dup *
+COMPONENT_PRIVATE int inline_find(const struct forth_byte_code* fbc, const int* functions, int functions_count, const char* name) {
+	for (int i = 0; i < functions_count; i++) {
+		if (strcmp(fbc->stream[functions[i] + 1].data.name, name) == 0)
+			return functions[i];
+	}
+	return -1;
+}
+
+COMPONENT_PRIVATE bool optimize_inline(struct forth_byte_code* fbc) {
+	int* functions = malloc((fbc->count + 1) * sizeof(int)); // positions of inlinable words
+	int* body_size = malloc((fbc->count + 1) * sizeof(int)); // body size by position of :
+	int functions_count = 0;
+	for (int position = 0; position < fbc->count; position++) {
+		body_size[position] = fbc->stream[position].type == tt_function ? inline_body_size(fbc, position) : -1;
+		if (body_size[position] >= 0)
+			functions[functions_count++] = position;
+	}
+
+	int calls = 0;
+	int new_count = 0;
+	for (int position = 0; position < fbc->count and functions_count > 0; position++) {
+		const struct token current_token = fbc->stream[position];
+		int function = -1;
+		if (current_token.type == tt_ident and not is_definition_name(fbc->stream, position))
+			function = inline_find(fbc, functions, functions_count, current_token.data.name);
+		calls += function >= 0;
+		new_count += function >= 0 ? body_size[function] : 1;
+	}
+
+	if (calls > 0) {
+		struct token* stream = calloc(new_count > 0 ? new_count : 1, sizeof(struct token));
+		int out = 0;
+		for (int position = 0; position < fbc->count; position++) {
+			const struct token current_token = fbc->stream[position];
+			int function = -1;
+			if (current_token.type == tt_ident and not is_definition_name(fbc->stream, position))
+				function = inline_find(fbc, functions, functions_count, current_token.data.name);
+
+			if (function < 0) {
+				stream[out++] = current_token;
+				continue;
+			}
+
+			for (int i = 0; i < body_size[function]; i++)
+				stream[out++] = copy_token(fbc->stream[function + 2 + i]);
+			body_size[position] = -2; // call replaced, release after copy of all bodies
+		}
+
+		for (int position = 0; position < fbc->count; position++) {
+			if (body_size[position] == -2)
+				release_token(fbc->stream[position]);
+		}
+		free(fbc->stream);
+		fbc->stream = stream;
+		fbc->count = new_count;
+	}
+
+	free(functions);
+	free(body_size);
+	return calls > 0;
+}
+
+COMPONENT_PRIVATE void optimize(struct forth_byte_code* fbc, int optimization_level) {
+	if (optimization_level >= 2)
+		optimize_inline(fbc);
+
+	if (optimization_level >= 1) {
+		for (int round = 0; round < FORTH_OPTIMIZE_MAX_ROUNDS; round++) {
+			bool changed = optimize_fold(fbc);
+			changed |= optimize_constants(fbc);
+			changed |= optimize_branches(fbc);
+			if (not changed)
+				break;
+		}
+	}
+}
+
+// ------------------------- CALLS RESOLVE -------------------------
+
+// call is in tail position when only then tokens are between call and ;
+// then of if with else is reached from else branch, nothing left on return stack
+COMPONENT_PRIVATE bool is_tail_position(const struct forth_byte_code* fbc, int position) {
+	for (int i = position + 1; i < fbc->count; i++) {
+		if (fbc->stream[i].type == tt_semicolon)
+			return true;
+		if (fbc->stream[i].type != tt_then)
+			return false;
+	}
+	return false;
+}
+
+// bind recurse to position of function name, mark tail calls
+COMPONENT_PRIVATE void resolve_calls(struct forth_byte_code* fbc) {
+	int function_name = -1;
+	for (int position = 0; position < fbc->count; position++) {
+		struct token* current_token = &fbc->stream[position];
+		switch (current_token->type) {
+		case tt_function:
+			function_name = position + 1;
+			break;
+
+		case tt_semicolon:
+			function_name = -1;
+			break;
+
+		case tt_recurse:
+			current_token->data.integer = function_name;
+			if (function_name >= 0 and is_tail_position(fbc, position))
+				current_token->type = tt_tail_recurse;
+			break;
+
+		case tt_ident:
+			if (function_name >= 0 and not is_definition_name(fbc->stream, position) and is_tail_position(fbc, position))
+				current_token->type = tt_tail_call;
+			break;
+
+		default:
 			break;
+		}
+	}
+}
+
+// control flow words must be closed inside of word, words can not be nested
+COMPONENT_PRIVATE bool check_program(const struct forth_byte_code* fbc, char* diagnostic, size_t size) {
+	enum token_type open[64];
+	int depth = 0;
+	const char* word = "top level";
+	for (int position = 0; position < fbc->count; position++) {
+		enum token_type type = fbc->stream[position].type;
+		enum token_type expected = tt_none; // opener of closing word
+		switch (type) {
+		case tt_function:
+			if (depth > 0) {
+				snprintf(diagnostic, size, "Error : inside of %s, missing %s", word, open[depth - 1] == tt_function ? ";" : "closing word");
+				return false;
+			}
+			word = position + 1 < fbc->count and fbc->stream[position + 1].type == tt_ident ? fbc->stream[position + 1].data.name : "unnamed word";
+			// fall through
+		case tt_if:
+		case tt_do:
+		case tt_begin:
+			if (depth == array_size(open)) {
+				snprintf(diagnostic, size, "Error control flow too deep in %s", word);
+				return false;
+			}
+			open[depth++] = type;
+			continue;
+
+		case tt_else:
+			if (depth == 0 or open[depth - 1] != tt_if) {
+				snprintf(diagnostic, size, "Error else without if in %s", word);
+				return false;
+			}
+			continue;
+
+		case tt_then: expected = tt_if; break;
+		case tt_loop: expected = tt_do; break;
+		case tt_until: expected = tt_begin; break;
+		case tt_semicolon: expected = tt_function; break;
+		default: continue;
+		}
+
+		if (depth == 0) {
+			snprintf(diagnostic, size, "Error %s without %s in %s", token_names[type], token_names[expected], word);
+			return false;
+		}
+		if (open[depth - 1] != expected) {
+			snprintf(diagnostic, size, "Error %s not closed before %s in %s", token_names[open[depth - 1]], token_names[type], word);
+			return false;
+		}
+		depth--;
+		if (type == tt_semicolon) {
+			word = "top level";
+		}
+	}
+
+	if (depth > 0) {
+		snprintf(diagnostic, size, "Error %s not closed in %s", token_names[open[depth - 1]], word);
+		return false;
+	}
+	return true;
+}
+
+// compile source of reader, on error return NULL with diagnostic
+COMPONENT_PRIVATE struct forth_byte_code* compile_reader(struct source_reader* reader, int optimization_level, bool lazy, char* diagnostic, size_t size) {
+	diagnostic[0] = '\0';
+	struct forth_byte_code* fbc = tokenizer(reader, lazy);
+	if (fbc == NULL) {
+		snprintf(diagnostic, size, "Error out of memory");
+		return NULL;
+	}
+	if (reader->failed) { // program of source part is not returned
+		snprintf(diagnostic, size, "Error read of source failed at offset %d", (int)reader->offset);
+		forth_release_byte_code(fbc);
+		return NULL;
+	}
+	if (reader->unterminated != NULL) { // comments and strings must be closed
+		snprintf(diagnostic, size, "Error unterminated %s at offset %d", reader->unterminated, (int)reader->unterminated_offset);
+		forth_release_byte_code(fbc);
+		return NULL;
+	}
+	if (not check_program(fbc, diagnostic, size)) {
+		forth_release_byte_code(fbc);
+		return NULL;
+	}
+
+	fbc->optimization_level = optimization_level;
+	optimize(fbc, optimization_level);
+	resolve_calls(fbc);
+	return fbc;
+}
+
+COMPONENT_PRIVATE struct forth_byte_code* compile_diagnostic(const char* script, int optimization_level, bool lazy, char* diagnostic, size_t size) {
+	struct source_reader reader = { .read = string_source, .context = &script };
+	return compile_reader(&reader, optimization_level, lazy, diagnostic, size);
+}
+
+COMPONENT_PRIVATE struct forth_byte_code* compile_source(struct source_reader* reader, int optimization_level, bool lazy) {
+	char diagnostic[128];
+	struct forth_byte_code* fbc = compile_reader(reader, optimization_level, lazy, diagnostic, sizeof(diagnostic));
+	if (fbc == NULL) {
+		printf("%s", diagnostic);
+	}
+	return fbc;
+}
+
+COMPONENT_PRIVATE struct forth_byte_code* compile(const char* script, int optimization_level, bool lazy) {
+	struct source_reader reader = { .read = string_source, .context = &script };
+	return compile_source(&reader, optimization_level, lazy);
+}
+
+// ------------------------- TREE SHAKING -------------------------
+
+// Program is cut to units: word definition, "variable name [n allot]" and "literal constant name".
+// Units reached from entry words and from other top level code are kept, top level code is kept always.
+
+struct strip_unit {
+	const char* name;
+	int begin;
+	int end; // position after last token
+	bool kept;
+};
+
+COMPONENT_PRIVATE bool is_literal(enum token_type type) {
+	return type == tt_value or type == tt_float_value;
+}
 
-		case tt_invert:
-			invert_op(fs);
-			break;
+// return count of units, constant with computed value stay as top level code
+COMPONENT_PRIVATE int strip_units(const struct forth_byte_code* fbc, struct strip_unit* units) {
+	const struct token* stream = fbc->stream;
+	int count = 0;
+	int top_level_begin = 0; // first position after last unit
+	for (int position = 0; position + 1 < fbc->count; position++) {
+		enum token_type type = stream[position].type;
+		if (stream[position + 1].type != tt_ident) {
+			continue;
+		}
+		struct strip_unit unit = { .name = stream[position + 1].data.name, .begin = position, .end = position + 2 };
+		if (type == tt_function) {
+			while (unit.end < fbc->count and stream[unit.end - 1].type != tt_semicolon) {
+				unit.end++;
+			}
+		} else if (type == tt_variable) {
+			if (position + 3 < fbc->count and is_literal(stream[position + 2].type) and stream[position + 3].type == tt_allot) {
+				unit.end = position + 4;
+			}
+		} else if (type == tt_constant and position > top_level_begin and is_literal(stream[position - 1].type)) {
+			unit.begin = position - 1;
+		} else {
+			continue;
+		}
+		units[count++] = unit;
+		position = unit.end - 1;
+		top_level_begin = unit.end;
+	}
+	return count;
+}
 
-		case tt_and:
-			and_op(fs);
-			break;
+COMPONENT_PRIVATE void strip_reach_tokens(const struct forth_byte_code* fbc, int begin, int end, const char** reached, int* reached_count) {
+	for (int position = begin; position < end; position++) {
+		enum token_type type = fbc->stream[position].type;
+		if ((type == tt_ident or type == tt_tail_call) and not is_definition_name(fbc->stream, position)) {
+			reached[(*reached_count)++] = fbc->stream[position].data.name;
+		}
+	}
+}
 
-		case tt_or:
-			or_op(fs);
-			break;
+// keep every definition of reached names, redefined word keep all bodies
+COMPONENT_PRIVATE void strip_reach(const struct forth_byte_code* fbc, struct strip_unit* units, int units_count, const char** reached, int reached_count) {
+	while (reached_count > 0) {
+		const char* name = reached[--reached_count];
+		for (int unit = 0; unit < units_count; unit++) {
+			if (units[unit].kept or strcmp(units[unit].name, name) != 0) {
+				continue;
+			}
+			units[unit].kept = true;
+			strip_reach_tokens(fbc, units[unit].begin, units[unit].end, reached, &reached_count);
+		}
+	}
+}
 
-		case tt_plus:
-			plus_op(fs);
-			break;
+COMPONENT_PRIVATE struct forth_byte_code* strip(const struct forth_byte_code* fbc, const char** entry_names, int entry_count) {
+	struct strip_unit* units = malloc(fbc->count * sizeof(*units) + 1);
+	const char** reached = malloc((fbc->count + entry_count) * sizeof(*reached) + 1); // every ident is pushed once at most
+	int* moved = malloc(fbc->count * sizeof(*moved) + 1); // new position of token, -1 if removed
+	struct forth_byte_code* stripped = malloc(sizeof(struct forth_byte_code));
+	struct token* stream = malloc(fbc->count * sizeof(struct token) + 1);
+	if (units == NULL or reached == NULL or moved == NULL or stripped == NULL or stream == NULL) {
+		free(units);
+		free(reached);
+		free(moved);
+		free(stripped);
+		free(stream);
+		return NULL;
+	}
 
-		case tt_minus:
-			minus_op(fs);
-			break;
+	int units_count = strip_units(fbc, units);
+	int reached_count = 0;
+	for (int entry = 0; entry < entry_count; entry++) {
+		reached[reached_count++] = entry_names[entry];
+	}
+	int top_level_begin = 0;
+	for (int unit = 0; unit <= units_count; unit++) { // top level code between units
+		int top_level_end = unit < units_count ? units[unit].begin : fbc->count;
+		strip_reach_tokens(fbc, top_level_begin, top_level_end, reached, &reached_count);
+		top_level_begin = unit < units_count ? units[unit].end : fbc->count;
+	}
+	strip_reach(fbc, units, units_count, reached, reached_count);
 
-		case tt_multip:
-			multiplication_op(fs);
-			break;
+	int count = 0;
+	int unit = 0;
+	for (int position = 0; position < fbc->count; position++) {
+		while (unit < units_count and units[unit].end <= position) {
+			unit++;
+		}
+		bool removed = unit < units_count and position >= units[unit].begin and not units[unit].kept;
+		moved[position] = removed ? -1 : count;
+		if (not removed) {
+			stream[count++] = copy_token(fbc->stream[position]);
+		}
+	}
 
-		case tt_div:
-			dividing_op(fs);
-			break;
+	for (int position = 0; position < count; position++) { // recurse jump to name of own word, always kept
+		enum token_type type = stream[position].type;
+		if ((type == tt_recurse or type == tt_tail_recurse) and stream[position].data.integer >= 0) {
+			stream[position].data.integer = moved[stream[position].data.integer];
+		}
+	}
 
-		case tt_mod:
-			mod_op(fs);
-			break;
+	stripped->stream = stream;
+	stripped->count = count;
+	stripped->optimization_level = fbc->optimization_level;
+	stripped->cache_entry = NULL;
+	forth_atomic_store(&stripped->running, 0);
+	free(units);
+	free(reached);
+	free(moved);
+	return stripped;
+}
 
-		case tt_at:
-			get_value_of_variable(fs);
-			break;
+// ------------------------- COMPILE CACHE -------------------------
 
-		case tt_setvalue:
-			set_value(fs);
-			break;
+// Programs compiled from same source and level are shared, entry live while somebody hold the program.
 
-		case tt_index:
-			loop_index_push(fs);
-			break;
+#if defined(_WIN32)
+	#define WIN32_LEAN_AND_MEAN
+	#define NOMINMAX
+	#include <windows.h>
+	typedef SRWLOCK forth_mutex;
+	#define FORTH_MUTEX_INIT SRWLOCK_INIT
+	#define forth_mutex_lock(mutex) AcquireSRWLockExclusive(mutex)
+	#define forth_mutex_unlock(mutex) ReleaseSRWLockExclusive(mutex)
+#else
+	#include <pthread.h>
+	typedef pthread_mutex_t forth_mutex;
+	#define FORTH_MUTEX_INIT PTHREAD_MUTEX_INITIALIZER
+	#define forth_mutex_lock(mutex) pthread_mutex_lock(mutex)
+	#define forth_mutex_unlock(mutex) pthread_mutex_unlock(mutex)
+#endif
+
+#define CACHE_BUCKETS 64
+
+struct cache_entry {
+	uint64_t hash;
+	int optimization_level;
+	char* source;
+	struct forth_byte_code* program;
+	int references;
+	struct cache_entry* next;
+};
 
-		case tt_allot:
-			allot_op(fs);
-			break;
+static struct cache_entry* cache_buckets[CACHE_BUCKETS];
+static forth_mutex cache_mutex = FORTH_MUTEX_INIT;
 
-		case tt_begin:
-			return_stack_push(fs, current_pos - 1);
-			break;
+COMPONENT_PRIVATE uint64_t source_hash(const char* source) { // FNV-1a
+	uint64_t hash = 14695981039346656037ULL;
+	for (const unsigned char* c = (const unsigned char*)source; *c; c++) {
+		hash ^= *c;
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
 
-		case tt_value:
-			stack_push(fs, current_token.data.integer);
-			break;
+// find entry and take reference, call with locked cache
+COMPONENT_PRIVATE struct forth_byte_code* cache_find(uint64_t hash, const char* source, int optimization_level) {
+	for (struct cache_entry* entry = cache_buckets[hash % CACHE_BUCKETS]; entry != NULL; entry = entry->next) {
+		if (entry->hash == hash and entry->optimization_level == optimization_level and strcmp(entry->source, source) == 0) {
+			entry->references++;
+			return entry->program;
+		}
+	}
+	return NULL;
+}
 
-		case tt_dotstring:
-			do_string_op(current_token);
-			break;
+COMPONENT_PRIVATE struct forth_byte_code* cache_compile(const char* source, int optimization_level) {
+	uint64_t hash = source_hash(source);
+	forth_mutex_lock(&cache_mutex);
+	struct forth_byte_code* program = cache_find(hash, source, optimization_level);
+	forth_mutex_unlock(&cache_mutex);
+	if (program != NULL) {
+		return program;
+	}
 
-		case tt_if:
-			current_pos = if_op(fs, stream, current_pos);
-			break;
+	// compile without lock, other thread can add same source meanwhile
+	struct forth_byte_code* compiled = compile(source, optimization_level, false);
+	struct cache_entry* entry = malloc(sizeof(struct cache_entry));
+	char* source_copy = strdup(source);
+	if (compiled == NULL or entry == NULL or source_copy == NULL) {
+		if (compiled != NULL)
+			forth_release_byte_code(compiled);
+		free(entry);
+		free(source_copy);
+		return NULL;
+	}
 
-		case tt_do:
-			current_pos = do_loop_start(fs, stream, current_pos);
-			break;
+	forth_mutex_lock(&cache_mutex);
+	program = cache_find(hash, source, optimization_level);
+	if (program == NULL) {
+		*entry = (struct cache_entry){ .hash = hash, .optimization_level = optimization_level, .source = source_copy,
+			.program = compiled, .references = 1, .next = cache_buckets[hash % CACHE_BUCKETS] };
+		compiled->cache_entry = entry;
+		cache_buckets[hash % CACHE_BUCKETS] = entry;
+		program = compiled;
+	}
+	forth_mutex_unlock(&cache_mutex);
 
-		case tt_loop:
-			current_pos = do_loop_end(fs, stream, current_pos); // jump to do token
-			break;
+	if (program != compiled) {
+		forth_release_byte_code(compiled);
+		free(entry);
+		free(source_copy);
+	}
+	return program;
+}
 
-		case tt_until:
-			current_pos = until_op(fs, current_pos);
-			break;
+// drop reference, return true if program must be released
+COMPONENT_PRIVATE bool cache_release(struct forth_byte_code* fbc) {
+	struct cache_entry* entry = fbc->cache_entry;
+	forth_mutex_lock(&cache_mutex);
+	entry->references--;
+	bool last = entry->references == 0;
+	if (last) {
+		struct cache_entry** link = &cache_buckets[entry->hash % CACHE_BUCKETS];
+		while (*link != entry)
+			link = &(*link)->next;
+		*link = entry->next;
+	}
+	forth_mutex_unlock(&cache_mutex);
 
-		case tt_constant:
-			current_pos = dictionary_add_from_token(fs, stream, current_pos, nt_constant, stack_pop(fs));
-			break;
+	if (last) {
+		free(entry->source);
+		free(entry);
+		fbc->cache_entry = NULL;
+	}
+	return last;
+}
 
-		case tt_variable:
-			current_pos = dictionary_add_from_token(fs, stream, current_pos, nt_variable, fs->integer_memory_pointer_top);
-			fs->integer_memory_pointer_top++;
-			break;
+// ------------------------- PARALLEL COMPILE -------------------------
 
-		case tt_function:
-			current_pos = dictionary_add_from_token(fs, stream, current_pos, nt_function, current_pos + 1);// +1 skip token name
-			break;
+// Scripts are compiled by worker threads, every worker take next script index until all are done.
+// Tokenizer, optimizer and key word tables have no shared mutable state.
 
-		case tt_ident:
-			current_pos = ident_op(fs, current_token.data.name, current_pos);
-			break;
+#if defined(_WIN32)
+	typedef HANDLE forth_thread;
+	#define FORTH_THREAD_FUNCTION(name, arg) DWORD WINAPI name(void* arg)
+	#define forth_thread_start(thread, function, arg) ((*(thread) = CreateThread(NULL, 0, function, arg, 0, NULL)) != NULL)
+	#define forth_thread_join(thread) (WaitForSingleObject(thread, INFINITE), CloseHandle(thread))
+#else
+	#include <unistd.h>
+	typedef pthread_t forth_thread;
+	#define FORTH_THREAD_FUNCTION(name, arg) void* name(void* arg)
+	#define forth_thread_start(thread, function, arg) (pthread_create(thread, NULL, function, arg) == 0)
+	#define forth_thread_join(thread) pthread_join(thread, NULL)
+#endif
 
-		
-		case tt_else: // jump to then
-		case tt_semicolon: // jump to call function position 
-			current_pos = return_stack_pop(fs);
-			break;
+#define COMPILE_MAX_THREADS 64
 
-			// not used
-		case tt_then:
-		case tt_cells:
-		//case tt_string:
-		case tt_none:
-			break;
+struct compile_job {
+	const char** scripts;
+	int count;
+	int optimization_level;
+	struct forth_compile_result* results;
+	forth_atomic_int next;
+};
 
-		default:
-			printf("Undefine operator from token: %s", current_token.data.name);
-			return;
-		}
+COMPONENT_PRIVATE int cpu_count() {
+#if defined(_WIN32)
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	return (int)info.dwNumberOfProcessors;
+#else
+	long count = sysconf(_SC_NPROCESSORS_ONLN);
+	return count > 0 ? (int)count : 1;
+#endif
+}
+
+COMPONENT_PRIVATE FORTH_THREAD_FUNCTION(compile_worker, arg) {
+	struct compile_job* job = arg;
+	for (int index = forth_atomic_fetch_add(&job->next, 1); index < job->count; index = forth_atomic_fetch_add(&job->next, 1)) {
+		struct forth_compile_result* result = &job->results[index];
+		result->program = compile_diagnostic(job->scripts[index], job->optimization_level, false, result->diagnostic, sizeof(result->diagnostic));
 	}
+	return 0;
 }
 
 // ------------------------- PUBLIC API -------------------------
@@ -784,13 +3782,29 @@ struct forth_state* forth_make_state(int data_size, int integer_memory_size, int
 		return NULL;
 	}
 
-	state->data_stack = calloc(data_size, sizeof(*state->data_stack));
+	guard_install();
+	state->data_stack = segment_alloc(data_size, sizeof(*state->data_stack));
 	state->data_stack_top = 0;
 
-	state->integer_memory = calloc(integer_memory_size, sizeof(*state->integer_memory));
+	state->float_stack = segment_alloc(data_size, sizeof(*state->float_stack));
+	state->float_stack_top = 0;
+
+	state->integer_memory = segment_alloc(integer_memory_size, sizeof(*state->integer_memory));
 	state->integer_memory_pointer_top = 0;
+	state->integer_memory_size = integer_memory_size;
+
+	state->heap_bottom = integer_memory_size;
+	for (int class = 0; class < HEAP_CLASSES; class++) {
+		state->heap_free[class] = -1;
+	}
+	state->heap_free_cells = 0;
+#if defined(FORTH_WORDS_HEAP)
+	state->heap_blocks = calloc(((size_t)integer_memory_size + 7) / 8, 1);
+#else
+	state->heap_blocks = NULL;
+#endif
 
-	state->return_stack = calloc(return_stack_size, sizeof(*state->return_stack));
+	state->return_stack = segment_alloc(return_stack_size, sizeof(*state->return_stack));
 	state->return_stack_top = 0;
 
 	state->dictionary = calloc(dictionary_size, sizeof(*state->dictionary));
@@ -798,6 +3812,25 @@ struct forth_state* forth_make_state(int data_size, int integer_memory_size, int
 
 	state->native_functions = calloc(native_functions_size, sizeof(*state->native_functions));
 	state->native_function_count = 0;
+
+	forth_atomic_store(&state->interrupt, 0);
+	state->pc = 0;
+	state->status = forth_ok;
+	state->suspended = false;
+
+	state->messages = NULL;
+	state->messages_mask = 0;
+	forth_atomic_store(&state->messages_head, 0);
+	forth_atomic_store(&state->messages_tail, 0);
+
+#if defined(FORTH_TRACE)
+	state->trace_head = 0;
+#endif
+
+	state->stats = (struct forth_stats){
+		.data_stack_size = data_size, .float_stack_size = data_size, .return_stack_size = return_stack_size,
+		.memory_size = integer_memory_size, .dictionary_size = dictionary_size, .native_functions_size = native_functions_size,
+	};
 	return state;
 }
 
@@ -806,28 +3839,129 @@ struct forth_state* forth_make_default_state() {
 }
 
 void forth_release_state(struct forth_state* fs) {
-	free(fs->data_stack);
-	free(fs->integer_memory);
-	free(fs->return_stack);
+	segment_free(fs->data_stack, fs->stats.data_stack_size, sizeof(*fs->data_stack));
+	segment_free(fs->float_stack, fs->stats.float_stack_size, sizeof(*fs->float_stack));
+	segment_free(fs->integer_memory, fs->integer_memory_size, sizeof(*fs->integer_memory));
+	segment_free(fs->return_stack, fs->stats.return_stack_size, sizeof(*fs->return_stack));
 	free(fs->dictionary);
+	free(fs->heap_blocks);
+	free(fs->messages);
 	free(fs);
 }
 
 void forth_release_byte_code(struct forth_byte_code* fbc) {
+	if (fbc->cache_entry != NULL and not cache_release(fbc)) {
+		return; // shared program still used
+	}
 	for (int index = 0; index < fbc->count; index++) {
-		const struct token current_token = fbc->stream[index];
-		enum token_type current_token_type = current_token.type;
-
-		if (current_token_type == tt_dotstring or current_token_type == tt_ident) {
-			free(current_token.data.name);
-		}
+		release_token(fbc->stream[index]);
 	}
 	free(fbc->stream);
 	free(fbc);
 }
 
 const struct forth_byte_code* forth_compile(const char* script) {
-	return tokenizer(script);
+	return forth_compile_optimized(script, 0);
+}
+
+const struct forth_byte_code* forth_compile_optimized(const char* script, int optimization_level) {
+	return compile(script, optimization_level, false);
+}
+
+const struct forth_byte_code* forth_compile_lazy(const char* script, int optimization_level) {
+	return compile(script, optimization_level, true);
+}
+
+const struct forth_byte_code* forth_strip(const struct forth_byte_code* program, const char** entry_names, int count) {
+	for (int position = 0; position < program->count; position++) {
+		if (program->stream[position].type == tt_lazy_body or program->stream[position].type == tt_jump) {
+			printf("Error strip of lazy program, body of word is not compiled");
+			return NULL;
+		}
+	}
+	for (int entry = 0; entry < count; entry++) {
+		if (definitions_count(program, entry_names[entry]) == 0) {
+			printf("Error entry word not found: %s", entry_names[entry]);
+			return NULL;
+		}
+	}
+	return strip(program, entry_names, count);
+}
+
+const struct forth_byte_code* forth_compile_stream(forth_read_function read, void* context, int optimization_level) {
+	struct source_reader reader = { .read = read, .context = context };
+	return compile_source(&reader, optimization_level, false);
+}
+
+const struct forth_byte_code* forth_compile_file(FILE* file, int optimization_level) {
+	return forth_compile_stream(file_source, file, optimization_level);
+}
+
+const struct forth_byte_code* forth_compile_fd(int fd, int optimization_level) {
+	return forth_compile_stream(fd_source, &fd, optimization_level);
+}
+
+const struct forth_byte_code* forth_compile_cached(const char* script, int optimization_level) {
+	return cache_compile(script, optimization_level);
+}
+
+int forth_compile_many(const char** scripts, int count, int optimization_level, int threads_count, struct forth_compile_result* results) {
+	struct compile_job job = { .scripts = scripts, .count = count, .optimization_level = optimization_level, .results = results };
+	forth_atomic_store(&job.next, 0);
+
+	threads_count = threads_count > 0 ? threads_count : cpu_count();
+	threads_count = threads_count < count ? threads_count : count;
+	threads_count = threads_count < COMPILE_MAX_THREADS ? threads_count : COMPILE_MAX_THREADS;
+
+	forth_thread threads[COMPILE_MAX_THREADS];
+	int started = 0;
+	while (started < threads_count - 1 and forth_thread_start(&threads[started], compile_worker, &job)) { // caller is last worker
+		started++;
+	}
+	compile_worker(&job);
+	for (int thread = 0; thread < started; thread++) {
+		forth_thread_join(threads[thread]);
+	}
+
+	int failed = 0;
+	for (int index = 0; index < count; index++) {
+		failed += results[index].program == NULL;
+	}
+	return failed;
+}
+
+// native of running script must not move stream of program under eval of caller
+COMPONENT_PRIVATE enum forth_status run_program(struct forth_state* fs, const struct forth_byte_code* program, int start_position, int end_position) {
+	struct forth_byte_code* running = (struct forth_byte_code*)program;
+	forth_atomic_fetch_add(&running->running, 1);
+	enum forth_status status = guarded_eval(fs, program, start_position, end_position);
+	forth_atomic_fetch_add(&running->running, -1);
+	return status;
+}
+
+bool forth_compile_append(struct forth_byte_code* fbc, const char* script) {
+	if (fbc->cache_entry != NULL) { // shared program is immutable
+		return false;
+	}
+	if (forth_atomic_load(&fbc->running) != 0) {
+		printf("Error append or reload of running program");
+		return false;
+	}
+	struct forth_byte_code* appended = (struct forth_byte_code*)forth_compile_optimized(script, fbc->optimization_level);
+	if (appended == NULL) {
+		return false;
+	}
+
+	return append_byte_code(fbc, appended) >= 0;
+}
+
+bool forth_reload(struct forth_state* fs, struct forth_byte_code* program, const char* script) {
+	int appended_position = program->count;
+	if (not forth_compile_append(program, script)) {
+		return false;
+	}
+	fs->status = run_program(fs, program, appended_position, program->count);
+	return true;
 }
 
 bool forth_run_function(struct forth_state* fs, const struct forth_byte_code* script, const char* func_name) {
@@ -835,25 +3969,141 @@ bool forth_run_function(struct forth_state* fs, const struct forth_byte_code* sc
 		return false;
 	}
 	drop_op(fs); // skip type (type is nt_function)
-	int func_start_position = stack_pop(fs);
-	int func_end_position = find_controll_flow_token(script->stream, func_start_position, tt_none, tt_semicolon); // skip function body
-	eval(fs, script->stream, func_start_position+1, func_end_position);
+	int func_start_position = (int)stack_pop(fs);
+	return_stack_push(fs, return_to_host); // ; of function stop eval, tail calls can leave function body
+	int profile_depth = profile_run_begin(fs);
+	profile_call(fs, script, func_start_position, false);
+	fs->status = run_program(fs, script, func_start_position+1, script->count);
+	profile_run_end(fs, profile_depth);
+	return true;
+}
+
+enum forth_status forth_run(struct forth_state* fs, const struct forth_byte_code* script) {
+	int profile_depth = profile_run_begin(fs);
+	fs->status = run_program(fs, script, 0, script->count);
+	profile_run_end(fs, profile_depth);
+	return fs->status;
+}
+
+void forth_interrupt(struct forth_state* fs) {
+	forth_atomic_store(&fs->interrupt, 1);
+}
+
+enum forth_status forth_resume(struct forth_state* fs, const struct forth_byte_code* script) {
+	if (fs->suspended or (fs->status != forth_interrupted and fs->status != forth_pending)) {
+		return fs->status;
+	}
+	fs->status = run_program(fs, script, fs->pc, script->count);
+	return fs->status;
+}
+
+enum forth_status forth_get_status(struct forth_state* fs) {
+	return fs->status;
+}
+
+void forth_suspend(struct forth_state* fs) {
+	fs->suspended = true;
+}
+
+void forth_complete_pending(struct forth_state* fs, const forth_cell* results, int count) {
+	for (int index = 0; index < count; index++) {
+		stack_push(fs, results[index]);
+	}
+	fs->suspended = false;
+}
+
+bool forth_set_message_queue(struct forth_state* fs, int capacity) {
+	int size = 2;
+	while (size <= capacity) { // one slot stay empty to tell full from empty
+		size *= 2;
+	}
+	forth_cell* messages = calloc(size, sizeof(*messages));
+	if (messages == NULL) {
+		return false;
+	}
+	free(fs->messages);
+	fs->messages = messages;
+	fs->messages_mask = size - 1;
+	forth_atomic_store(&fs->messages_head, 0);
+	forth_atomic_store(&fs->messages_tail, 0);
+	return true;
+}
+
+bool forth_post_message(struct forth_state* fs, forth_cell message) {
+	if (fs->messages == NULL) {
+		return false;
+	}
+	int head = forth_atomic_load(&fs->messages_head);
+	int next = (head + 1) & fs->messages_mask;
+	if (next == forth_atomic_load(&fs->messages_tail)) { // full
+		return false;
+	}
+	fs->messages[head] = message;
+	forth_atomic_store(&fs->messages_head, next); // publish message after write
 	return true;
 }
 
-void forth_run(struct forth_state* fs, const struct forth_byte_code* script) {
-	eval(fs, script->stream, 0, script->count);
+void forth_run_batch(struct forth_state** states, int count, const struct forth_byte_code* script) {
+	for (int first = 0; first < count; first += FORTH_BATCH_LANES) {
+		int lanes = count - first < FORTH_BATCH_LANES ? count - first : FORTH_BATCH_LANES;
+		struct forth_state* accepted[FORTH_BATCH_LANES];
+		struct batch group = { .states = accepted, .lanes = 0 };
+		for (int lane = 0; lane < lanes; lane++) {
+			struct forth_state* fs = states[first + lane];
+			fs->status = batch_accept(fs) ? forth_ok : forth_error;
+			if (fs->status == forth_ok) {
+				accepted[group.lanes++] = fs;
+			}
+		}
+		if (group.lanes == 0) {
+			continue;
+		}
+
+		int position = 0;
+		if (batch_load(&group)) {
+			forth_atomic_fetch_add(&((struct forth_byte_code*)script)->running, 1);
+			position = guarded_batch_eval(&group, script);
+			forth_atomic_fetch_add(&((struct forth_byte_code*)script)->running, -1);
+		}
+		for (int lane = 0; lane < group.lanes; lane++) {
+			struct forth_state* fs = group.states[lane];
+			if (fs->status == forth_error or fs->status == forth_interrupted) { // lane stopped in lockstep
+				continue;
+			} else if (fs->suspended) { // native of lane suspended in lockstep
+				fs->pc = position;
+				fs->status = forth_pending;
+			} else {
+				fs->status = position < script->count ? run_program(fs, script, position, script->count) : forth_ok;
+			}
+		}
+	}
 }
 
-void forth_data_stack_push(struct forth_state* fs, int value) {
+void forth_data_stack_push(struct forth_state* fs, forth_cell value) {
 	stack_push(fs, value);
 }
 
-int forth_data_stack_pop(struct forth_state* fs) {
+forth_cell forth_data_stack_pop(struct forth_state* fs) {
 	return stack_pop(fs);
 }
 
-void forth_set_constant(struct forth_state* fs, const char* name, int value) {
+void forth_float_stack_push(struct forth_state* fs, forth_float value) {
+	float_push(fs, value);
+}
+
+forth_float forth_float_stack_pop(struct forth_state* fs) {
+	return float_pop(fs);
+}
+
+forth_cell forth_memory_get(struct forth_state* fs, int address) {
+	return fs->integer_memory[address];
+}
+
+void forth_memory_set(struct forth_state* fs, int address, forth_cell value) {
+	fs->integer_memory[address] = value;
+}
+
+void forth_set_constant(struct forth_state* fs, const char* name, forth_cell value) {
 	dictionary_add_from_name(fs, name, nt_constant, value);
 }
 
@@ -863,6 +4113,88 @@ void forth_set_function(struct forth_state* fs, const char* name, forth_native_f
 	fs->native_function_count += 1;
 }
 
+void forth_get_stats(struct forth_state* fs, struct forth_stats* stats) {
+	*stats = fs->stats;
+	stats->data_stack_max = fs->data_stack_top > stats->data_stack_max ? fs->data_stack_top : stats->data_stack_max; // host pushes
+	stats->float_stack_max = fs->float_stack_top > stats->float_stack_max ? fs->float_stack_top : stats->float_stack_max;
+	stats->memory_used = fs->integer_memory_pointer_top;
+	stats->heap_size = fs->integer_memory_size - fs->heap_bottom;
+	stats->heap_free = fs->heap_free_cells;
+	stats->dictionary_count = fs->dictionary_count;
+	stats->native_function_count = fs->native_function_count;
+}
+
+void forth_reset_stats(struct forth_state* fs) {
+	fs->stats.instructions = 0;
+	fs->stats.native_calls = 0;
+	fs->stats.data_stack_max = fs->data_stack_top;
+	fs->stats.float_stack_max = fs->float_stack_top;
+	fs->stats.return_stack_max = fs->return_stack_top;
+}
+
+#if defined(FORTH_TRACE)
+
+void forth_trace_dump(struct forth_state* fs, const struct forth_byte_code* program, FILE* output) {
+	trace_print(fs, program, output);
+}
+
+#endif // FORTH_TRACE
+
+#if defined(FORTH_PROFILER)
+
+bool forth_profiler_start(int frequency) {
+	struct sigaction action = { 0 };
+	action.sa_handler = profile_signal;
+	action.sa_flags = SA_RESTART;
+	sigemptyset(&action.sa_mask);
+	if (sigaction(SIGPROF, &action, &profile_old_action) != 0) {
+		return false;
+	}
+
+	long interval = 1000000L / (frequency > 0 ? frequency : 1);
+	struct itimerval timer = { 0 };
+	timer.it_interval.tv_sec = interval / 1000000L;
+	timer.it_interval.tv_usec = interval % 1000000L;
+	timer.it_value = timer.it_interval;
+	return setitimer(ITIMER_PROF, &timer, NULL) == 0;
+}
+
+void forth_profiler_stop() {
+	struct itimerval timer = { 0 };
+	setitimer(ITIMER_PROF, &timer, NULL);
+	sigaction(SIGPROF, &profile_old_action, NULL);
+}
+
+// label of position in program, "?" if position is out of program (sampled before eval set it)
+COMPONENT_PRIVATE const char* profile_label(const struct forth_byte_code* program, int position) {
+	return position >= 0 and position < program->count ? token_label(&program->stream[position]) : "?";
+}
+
+int forth_profiler_dump(FILE* output) {
+	while (forth_atomic_fetch_add(&profile_busy, 1) != 0) { // handlers of other threads drop samples while table is read
+		forth_atomic_fetch_add(&profile_busy, -1);
+	}
+	for (int index = 0; index < PROFILE_SAMPLES; index++) {
+		struct profile_sample* sample = &profile_samples[index];
+		if (sample->count == 0) {
+			continue;
+		}
+		fprintf(output, "top level");
+		for (int frame = 0; frame < sample->depth; frame++) {
+			fprintf(output, ";%s", profile_label(sample->programs[frame], sample->frames[frame]));
+		}
+		fprintf(output, ";%s@%d %d\n", profile_label(sample->program, sample->pc), sample->pc, sample->count);
+		sample->count = 0;
+	}
+	forth_atomic_fetch_add(&profile_busy, -1);
+
+	int dropped = forth_atomic_load(&profile_dropped);
+	forth_atomic_store(&profile_dropped, 0);
+	return dropped;
+}
+
+#endif // FORTH_PROFILER
+
 void forth_set_user_data(struct forth_state* fs, void* user_data) {
 	fs->user_data = user_data;
 }
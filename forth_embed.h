@@ -1,15 +1,63 @@
 #pragma once
 #include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
 
 // Public API
 
+// Cell of stacks, memory and literals, selected at build time by FORTH_CELL_TYPE (int32, int64, intptr)
+#if defined(FORTH_CELL_INT64)
+	typedef int64_t forth_cell;
+	#define FORTH_CELL_BITS 64
+#elif defined(FORTH_CELL_INTPTR)
+	typedef intptr_t forth_cell;
+	#if INTPTR_MAX == INT64_MAX
+		#define FORTH_CELL_BITS 64
+	#else
+		#define FORTH_CELL_BITS 32
+	#endif
+#else
+	typedef int32_t forth_cell;
+	#define FORTH_CELL_BITS 32
+#endif
+
+// Float of float stack, same size as cell
+#if FORTH_CELL_BITS == 64
+	typedef double forth_float;
+#else
+	typedef float forth_float;
+#endif
+
+// Word sets compiled into tokenizer and eval, selected at build time by FORTH_WORD_SETS (bulk, float, heap, message).
+// Core words are always compiled, without FORTH_WORDS_SELECTED every set is compiled.
+#if !defined(FORTH_WORDS_SELECTED)
+	#define FORTH_WORDS_BULK
+	#define FORTH_WORDS_FLOAT
+	#define FORTH_WORDS_HEAP
+	#define FORTH_WORDS_MESSAGE
+#endif
+
 // Interface struct
 struct forth_byte_code;
 struct forth_state;
 
+enum forth_status {
+	forth_ok, // program done
+	forth_interrupted, // stopped by forth_interrupt, continue with forth_resume
+	forth_pending, // native called forth_suspend, continue with forth_complete_pending and forth_resume
+	forth_error, // stack or memory overflow caught by guard page (FORTH_GUARDED_STACKS build), stacks are cleared
+};
+
 // forth stack manipulation
-void forth_data_stack_push(struct forth_state* fs, int value);
-int forth_data_stack_pop(struct forth_state* fs);
+void forth_data_stack_push(struct forth_state* fs, forth_cell value);
+forth_cell forth_data_stack_pop(struct forth_state* fs);
+void forth_float_stack_push(struct forth_state* fs, forth_float value);
+forth_float forth_float_stack_pop(struct forth_state* fs);
+
+// forth integer memory access (variables, allot)
+forth_cell forth_memory_get(struct forth_state* fs, int address);
+void forth_memory_set(struct forth_state* fs, int address, forth_cell value);
 
 
 // Create forth stack from run/eval program
@@ -20,17 +68,122 @@ void forth_release_state(struct forth_state* fs);
 typedef void (*forth_native_function)(struct forth_state* fs);
 
 // Set user constants, variables or functions
-void forth_set_constant(struct forth_state* fs, const char* name, int value);
+void forth_set_constant(struct forth_state* fs, const char* name, forth_cell value);
 void forth_set_function(struct forth_state* fs, const char* name, forth_native_function func);
 
 
 // Run code or function
-void forth_run(struct forth_state* fs, const struct forth_byte_code* script);
+enum forth_status forth_run(struct forth_state* fs, const struct forth_byte_code* script);
 bool forth_run_function(struct forth_state* fs, const struct forth_byte_code* script, const char* func_name);
 
+// Watchdog: safe to call from other thread or signal handler while script runs.
+// Script stops before next loop, until or word call, state keep stacks and can be resumed.
+void forth_interrupt(struct forth_state* fs);
+enum forth_status forth_resume(struct forth_state* fs, const struct forth_byte_code* script);
+enum forth_status forth_get_status(struct forth_state* fs); // status of last run, resume, run_function or reload
+
+// Asynchronous natives: native call forth_suspend(fs) and return, script stops after the call.
+// When result is ready forth_complete_pending push results to data stack, then forth_resume continues script.
+// Not call forth_complete_pending while state runs, complete and resume from other threads need own synchronization.
+void forth_suspend(struct forth_state* fs);
+void forth_complete_pending(struct forth_state* fs, const forth_cell* results, int count);
+
+// Message queue: one host thread post messages while script runs, script read them with
+// ?message ( -- flag ) and receive ( -- message ), receive of empty queue push 0.
+// Set queue before script run and posts start, set again drop queued messages.
+bool forth_set_message_queue(struct forth_state* fs, int capacity);
+bool forth_post_message(struct forth_state* fs, forth_cell message); // false if queue is full or not set
+
+// Run code for many states in lockstep, like forth_run for every state.
+// States must have same data stack depth, state with values on return or float stack is not run and get forth_error,
+// prints of states can interleave.
+// While all states take same branches math and stack words run for 8 states at once,
+// after first divergent if/until/do every state runs alone.
+void forth_run_batch(struct forth_state** states, int count, const struct forth_byte_code* script);
+
+// Usage statistics: counters and stack depth maximums since make or reset, fill of memory and dictionary now.
+// Counters of running script are updated when run, resume or reload returns.
+struct forth_stats {
+	long long instructions; // tokens executed
+	long long native_calls;
+	int data_stack_max, data_stack_size;
+	int float_stack_max, float_stack_size;
+	int return_stack_max, return_stack_size;
+	int memory_used, memory_size; // cells of integer memory taken by variables and allot
+	int heap_size, heap_free; // cells of integer memory taken by heap, cells of free blocks in heap
+	int dictionary_count, dictionary_size;
+	int native_function_count, native_functions_size;
+};
+void forth_get_stats(struct forth_state* fs, struct forth_stats* stats);
+void forth_reset_stats(struct forth_state* fs);
+
+#if defined(FORTH_PROFILER)
+// Sampling profiler (POSIX): SIGPROF timer samples words called by scripts running at signal on every thread.
+// Dump writes collapsed stacks "top level;word;word;token@position count" for flame graphs and clears samples,
+// programs of samples must be alive, return count of samples dropped.
+// Position is index of token in compiled program (after optimization and lazy bodies), as in trace, not offset in source.
+bool forth_profiler_start(int frequency); // samples per second of cpu time
+void forth_profiler_stop();
+int forth_profiler_dump(FILE* output);
+#endif
+
+#if defined(FORTH_TRACE)
+// Trace: state keep last FORTH_TRACE_SIZE steps of eval (position, token, top of data stack), printed on error.
+// Dump print steps oldest first with word names of program.
+void forth_trace_dump(struct forth_state* fs, const struct forth_byte_code* program, FILE* output);
+#endif
+
 void forth_set_user_data(struct forth_state* fs, void* user_data);
 void* forth_get_user_data(struct forth_state* fs);
 
 // Compile and release functions
 const struct forth_byte_code* forth_compile(const char* script);
-void forth_release_byte_code(struct forth_byte_code* fbc);
\ No newline at end of file
+void forth_release_byte_code(struct forth_byte_code* fbc);
+
+// Optimization levels:
+// 0 - same as forth_compile
+// 1 - fold constant expressions, substitute script constants, remove branches of if on known values
+// 2 - level 1 and inline small not recursive words
+// Constants and words of the script must not be redefined by the host (forth_set_constant, forth_set_function)
+const struct forth_byte_code* forth_compile_optimized(const char* script, int optimization_level);
+
+// Lazy compile: only word boundaries are scanned, body of word is compiled on first call.
+// First call modify program, do not run one lazy program from several threads at once.
+const struct forth_byte_code* forth_compile_lazy(const char* script, int optimization_level);
+
+// Streaming compile: source is read by chunks, only chunk and current word are kept in memory.
+// Read function put up to size bytes of source to buffer and return count, 0 at end of source,
+// FORTH_READ_ERROR if read failed, then compile return NULL with diagnostic.
+#define FORTH_READ_ERROR ((size_t)-1)
+typedef size_t (*forth_read_function)(void* context, char* buffer, size_t size);
+const struct forth_byte_code* forth_compile_stream(forth_read_function read, void* context, int optimization_level);
+const struct forth_byte_code* forth_compile_file(FILE* file, int optimization_level); // read to end of file
+const struct forth_byte_code* forth_compile_fd(int fd, int optimization_level); // read to end of file, fd is not closed
+
+// Cached compile: same source and level return one shared program, safe from many threads.
+// Every forth_compile_cached need own forth_release_byte_code, program released with last reference.
+// Shared program is immutable, forth_compile_append and forth_reload refuse it.
+const struct forth_byte_code* forth_compile_cached(const char* script, int optimization_level);
+
+// Parallel compile of many scripts on threads_count threads (0 - one per cpu).
+// Result of every script is program or NULL with diagnostic (unclosed comment/string, unbalanced control flow),
+// return count of failed scripts.
+struct forth_compile_result {
+	const struct forth_byte_code* program;
+	char diagnostic[128]; // empty if compiled
+};
+int forth_compile_many(const char** scripts, int count, int optimization_level, int threads_count, struct forth_compile_result* results);
+
+// Tree shaking: new program with words, constants and variables used by entry words or top level code.
+// Run it like source program (forth_run) before forth_run_function of entry words, source program is not changed.
+// Constant with computed value is kept, lazy program is not stripped (NULL).
+const struct forth_byte_code* forth_strip(const struct forth_byte_code* program, const char** entry_names, int count);
+
+// Incremental compile: append script to end of program, positions of old words stay valid.
+// Append and reload refuse program which runs now (called from native of its script), return false.
+bool forth_compile_append(struct forth_byte_code* fbc, const char* script);
+
+// Hot reload: append script and run only appended part in live state.
+// Words defined again replace old definition for all callers, variables, memory and stacks are kept.
+// Words inlined or constants substituted by forth_compile_optimized keep old definition in callers.
+bool forth_reload(struct forth_state* fs, struct forth_byte_code* program, const char* script);
\ No newline at end of file
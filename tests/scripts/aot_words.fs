@@ -0,0 +1,18 @@
+( words translated to C by forth_translate, test_aot compare them with interpreter )
+variable total
+10 constant ten
+
+: sq dup * ;
+: fact dup 1 = invert if dup 1 - recurse * then ;
+: fib-iter 0 1 rot 0 do over + swap loop drop ;
+: classify dup ten = if drop 1 else 0 = if 2 else 3 then then ;
+: accumulate 0 do i total @ + total ! loop total @ ;
+: shuffle 1 2 3 rot swap over - ;
+: logic 1 1 = 2 3 = or 1 1 = and invert ;
+: math 100 7 mod 9 / 4 * 6 - ;
+: count-down begin 1 - dup 0 = invert until ;
+: sum-squares 0 swap 0 do i sq + loop ;
+: native-call host-value 2 * ;
+: greet ."Hello from C" cr ;
+: scale s>f 1.5 f* 0.25 f+ f>s ;
+: bounded s>f fdup -1e999 fswap f< 1e999 f< and ;
@@ -0,0 +1,78 @@
+#include "forth_embed.h"
+#include "aot_words.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+
+#define PASS() printf("Pass %s\n", __func__);
+
+static const char* words[] = { "sq", "fact", "fib-iter", "classify", "accumulate", "shuffle", "logic", "math", "count-down", "sum-squares", "native-call", "greet",
+#if defined(FORTH_WORDS_FLOAT)
+	"scale", "bounded", // interpreter compare need float words
+#endif
+};
+
+static char* read_script() {
+	FILE* file = fopen(FORTH_AOT_SCRIPT, "rb");
+	assert(file != NULL);
+	static char source[4096];
+	size_t read = fread(source, 1, sizeof(source) - 1, file);
+	source[read] = '\0';
+	fclose(file);
+	return source;
+}
+
+static void host_value(struct forth_state* fs) {
+	forth_data_stack_push(fs, 21);
+}
+
+// run word with argument, return hash of stack over marker
+static int run_word(struct forth_state* fs, const struct forth_byte_code* bc, const char* word, int argument) {
+	forth_data_stack_push(fs, 12345);
+	forth_data_stack_push(fs, argument);
+	assert(forth_run_function(fs, bc, word));
+
+	int hash = 0;
+	for (int value = forth_data_stack_pop(fs); value != 12345; value = forth_data_stack_pop(fs))
+		hash = hash * 31 + value;
+	return hash;
+}
+
+int translated_words() {
+	struct forth_state* interpreted = forth_make_state(50, 100, 40, 40, 10);
+	struct forth_state* native = forth_make_state(50, 100, 40, 40, 40);
+	struct forth_byte_code* bc = forth_compile(read_script());
+
+	forth_set_function(interpreted, "host-value", host_value);
+	forth_set_function(native, "host-value", host_value);
+	forth_run(interpreted, bc);
+	forth_aot_words_init();
+	forth_aot_words_register(native);
+	forth_aot_words_run(native);
+
+	struct forth_byte_code* calls[sizeof(words) / sizeof(words[0])]; // dictionary keep names of programs
+	for (int i = 0; i < sizeof(words) / sizeof(words[0]); i++) {
+		char source[64];
+		snprintf(source, sizeof(source), ": call %s ;", words[i]);
+		calls[i] = forth_compile(source);
+		forth_run(native, calls[i]);
+
+		for (int argument = 1; argument < 12; argument += 5) {
+			int expected = run_word(interpreted, bc, words[i], argument);
+			assert(run_word(native, calls[i], "call", argument) == expected);
+		}
+	}
+
+	forth_release_state(interpreted);
+	forth_release_state(native);
+	forth_release_byte_code(bc);
+	for (int i = 0; i < sizeof(words) / sizeof(words[0]); i++)
+		forth_release_byte_code(calls[i]);
+	PASS();
+	return 0;
+}
+
+int main(int argc, char** args) {
+	translated_words();
+	return 0;
+}
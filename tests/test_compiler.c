@@ -0,0 +1,286 @@
+#include "forth_embed.h"
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+#define PASS() printf("Pass %s\n", __func__);
+
+static const char* scripts[] = {
+	"2 3 + 4 * 10 - 7 mod",
+	"5 dup * 3 swap - 1 2 over rot",
+	"1 2 = 3 3 = or invert 2 1 < and",
+	"10 constant ten ten ten * ten /",
+	"3 constant three : add-three three + ; : test 4 add-three three 1 = if 1 else 2 then ; test",
+	": sq dup * ; : cube dup sq * ; 3 sq 2 cube + 4 sq sq",
+	": test -1 if 10 else 20 then 0 if 30 else 40 then 1 if 50 then 7 ; test",
+	": test 1 1 = if 2 2 = if 100 else 200 then else 300 then ; test",
+	"variable v 42 v ! : get v @ ; get 1 +",
+	": count-down begin 1 - dup 0 > until ; 10 count-down",
+	": fib-iter 0 1 rot 0 do over + swap loop drop ; 20 fib-iter",
+};
+
+int run_hash(const struct forth_byte_code* bc) {
+	struct forth_state* fs = forth_make_default_state();
+	int hash = 0;
+
+	forth_data_stack_push(fs, 12345); // bottom marker
+	forth_run(fs, bc);
+	for (int value = forth_data_stack_pop(fs); value != 12345; value = forth_data_stack_pop(fs))
+		hash = hash * 31 + value;
+
+	forth_release_state(fs);
+	return hash;
+}
+
+int optimization_levels() {
+	for (int i = 0; i < sizeof(scripts) / sizeof(scripts[0]); i++) {
+		struct forth_byte_code* bc0 = forth_compile(scripts[i]);
+		struct forth_byte_code* bc1 = forth_compile_optimized(scripts[i], 1);
+		struct forth_byte_code* bc2 = forth_compile_optimized(scripts[i], 2);
+		struct forth_byte_code* lazy = forth_compile_lazy(scripts[i], 2);
+
+		int expected = run_hash(bc0);
+		assert(run_hash(bc1) == expected);
+		assert(run_hash(bc2) == expected);
+		assert(run_hash(lazy) == expected);
+		assert(run_hash(lazy) == expected); // bodies compiled by first run
+
+		forth_release_byte_code(bc0);
+		forth_release_byte_code(bc1);
+		forth_release_byte_code(bc2);
+		forth_release_byte_code(lazy);
+	}
+	PASS();
+	return 0;
+}
+
+static struct forth_byte_code* reloaded;
+
+static void reload_running(struct forth_state* fs) {
+	forth_data_stack_push(fs, forth_reload(fs, reloaded, ": step 100 ;") ? 1 : 0);
+}
+
+int hot_reload() {
+	struct forth_state* fs = forth_make_default_state();
+	struct forth_byte_code* bc = forth_compile("variable counter : step 1 ; : tick counter @ step + counter ! ;");
+	forth_run(fs, bc);
+
+	forth_run_function(fs, bc, "tick");
+	forth_run_function(fs, bc, "tick");
+	forth_data_stack_push(fs, 77); // stack survive reload
+
+	assert(forth_reload(fs, bc, "variable counter : step 10 ; : read counter @ ;"));
+	forth_run_function(fs, bc, "tick");
+	forth_run_function(fs, bc, "read");
+	assert(forth_data_stack_pop(fs) == 12);
+	assert(forth_data_stack_pop(fs) == 77);
+
+	assert(forth_compile_append(bc, ": twice tick tick ;"));
+	forth_run(fs, bc); // full run define new word, keep variable
+	forth_run_function(fs, bc, "twice");
+	forth_run_function(fs, bc, "read");
+	assert(forth_data_stack_pop(fs) == 32);
+
+	reloaded = bc;
+	forth_set_function(fs, "reload-running", reload_running);
+	assert(forth_compile_append(bc, ": try reload-running step ;"));
+	forth_run(fs, bc);
+	forth_run_function(fs, bc, "try"); // stream of running program is not moved
+	printf("\n");
+	assert(forth_data_stack_pop(fs) == 10);
+	assert(forth_data_stack_pop(fs) == 0);
+
+	forth_release_state(fs);
+	forth_release_byte_code(bc);
+	PASS();
+	return 0;
+}
+
+int lazy_function() {
+	struct forth_state* fs = forth_make_default_state();
+	struct forth_byte_code* bc = forth_compile_lazy(": unused 1 2 3 ; : fact dup 1 = invert if dup 1 - recurse * then ; : empty ;", 0);
+	forth_run(fs, bc);
+
+	forth_data_stack_push(fs, 6);
+	assert(forth_run_function(fs, bc, "fact"));
+	assert(forth_run_function(fs, bc, "empty"));
+	forth_data_stack_push(fs, 5);
+	assert(forth_run_function(fs, bc, "fact"));
+	assert(forth_data_stack_pop(fs) == 120);
+	assert(forth_data_stack_pop(fs) == 720);
+
+	forth_release_state(fs);
+	forth_release_byte_code(bc);
+	PASS();
+	return 0;
+}
+
+static struct forth_byte_code* reentered;
+
+// native run word of program running it, lazy body of word is appended while caller runs
+static void reenter(struct forth_state* fs) {
+	forth_run_function(fs, reentered, "inner");
+}
+
+int lazy_reenter() {
+	struct forth_state* fs = forth_make_default_state();
+	reentered = forth_compile_lazy(": inner 1 2 + ; : outer reenter inner * ; : third 3 ; outer third", 0);
+	forth_set_function(fs, "reenter", reenter);
+	forth_run(fs, reentered);
+	assert(forth_data_stack_pop(fs) == 3);
+	assert(forth_data_stack_pop(fs) == 9);
+
+	forth_release_state(fs);
+	forth_release_byte_code(reentered);
+	PASS();
+	return 0;
+}
+
+int compile_cache() {
+	struct forth_byte_code* first = forth_compile_cached(scripts[5], 2);
+	struct forth_byte_code* second = forth_compile_cached(scripts[5], 2);
+	struct forth_byte_code* other_level = forth_compile_cached(scripts[5], 0);
+	assert(first == second); // shared program
+	assert(first != other_level);
+	assert(!forth_compile_append(first, ": more 1 ;")); // shared program is immutable
+
+	int expected = run_hash(other_level);
+	forth_release_byte_code(first);
+	assert(run_hash(second) == expected); // still alive for other owner
+	forth_release_byte_code(second);
+	forth_release_byte_code(other_level);
+
+	struct forth_byte_code* again = forth_compile_cached(scripts[5], 2); // compiled again after last release
+	assert(run_hash(again) == expected);
+	forth_release_byte_code(again);
+	PASS();
+	return 0;
+}
+
+int compile_many() {
+	const char* sources[sizeof(scripts) / sizeof(scripts[0]) + 4];
+	int count = sizeof(scripts) / sizeof(scripts[0]);
+	for (int i = 0; i < count; i++)
+		sources[i] = scripts[i];
+	sources[count + 0] = "1 2 ( not closed comment";
+	sources[count + 1] = ": broken 1 if 2 ;";
+	sources[count + 2] = ": words .\" not closed string ;";
+	sources[count + 3] = ": outer : inner ; ;";
+
+	struct forth_compile_result results[sizeof(sources) / sizeof(sources[0])];
+	assert(forth_compile_many(sources, count + 4, 1, 4, results) == 4);
+	for (int i = 0; i < count; i++) {
+		struct forth_byte_code* sequential = forth_compile_optimized(scripts[i], 1);
+		assert(results[i].program != NULL && results[i].diagnostic[0] == '\0');
+		assert(run_hash(results[i].program) == run_hash(sequential));
+		forth_release_byte_code(sequential);
+		forth_release_byte_code(results[i].program);
+	}
+	for (int i = count; i < count + 4; i++) {
+		assert(results[i].program == NULL && results[i].diagnostic[0] != '\0');
+		printf("%s\n", results[i].diagnostic);
+	}
+	PASS();
+	return 0;
+}
+
+struct chunks {
+	const char* source;
+	size_t size; // tiny chunks split words, strings and comments
+};
+
+size_t read_chunk(void* context, char* buffer, size_t size) {
+	struct chunks* chunks = context;
+	size_t count = 0;
+	while (count < size && count < chunks->size && chunks->source[count] != '\0')
+		count++;
+	memcpy(buffer, chunks->source, count);
+	chunks->source += count;
+	return count;
+}
+
+// source ends with read error instead of end of source
+size_t read_failing(void* context, char* buffer, size_t size) {
+	size_t count = read_chunk(context, buffer, size);
+	return count > 0 ? count : FORTH_READ_ERROR;
+}
+
+int compile_stream() {
+	const char* commented = "( header comment ) : greet .\" hello stream\" 7 ; greet 100 ( two ) 200 + : total 0 swap 0 do i + loop ; 10 total";
+	for (int i = 0; i <= sizeof(scripts) / sizeof(scripts[0]); i++) {
+		const char* script = i < sizeof(scripts) / sizeof(scripts[0]) ? scripts[i] : commented;
+		struct forth_byte_code* whole = forth_compile_optimized(script, 1);
+		for (size_t size = 1; size <= 5; size += 2) {
+			struct chunks chunks = { script, size };
+			struct forth_byte_code* streamed = forth_compile_stream(read_chunk, &chunks, 1);
+			assert(streamed != NULL && run_hash(streamed) == run_hash(whole));
+			forth_release_byte_code(streamed);
+		}
+		forth_release_byte_code(whole);
+	}
+
+	struct chunks unclosed = { ": words .\" not closed ;", 2 };
+	assert(forth_compile_stream(read_chunk, &unclosed, 0) == NULL);
+	printf("\n");
+	struct chunks failing = { "1 2 + 3 *", 4 };
+	assert(forth_compile_stream(read_failing, &failing, 0) == NULL); // read prefix is not a program
+	printf("\n");
+	assert(forth_compile_fd(-1, 0) == NULL);
+	printf("\n");
+
+	FILE* file = tmpfile();
+	fputs(commented, file);
+	rewind(file);
+	struct forth_byte_code* from_file = forth_compile_file(file, 0);
+	struct forth_byte_code* whole = forth_compile(commented);
+	assert(from_file != NULL && run_hash(from_file) == run_hash(whole));
+	forth_release_byte_code(from_file);
+	forth_release_byte_code(whole);
+	fclose(file);
+	PASS();
+	return 0;
+}
+
+int strip_words() {
+	const char* library = ""
+		": unused 1 2 + ; "
+		": fact dup 1 < if dup 1 - recurse * then ; "
+		": sq dup * ; "
+		"5 constant five 7 constant spare "
+		"variable buffer 10 allot variable total "
+		": main five fact total ! total @ sq ; "
+		"spare drop";
+	const char* entries[] = { "main" };
+	struct forth_byte_code* full = forth_compile_optimized(library, 1);
+	struct forth_byte_code* stripped = forth_strip(full, entries, 1);
+	assert(stripped != NULL);
+
+	struct forth_state* fs = forth_make_default_state();
+	forth_run(fs, stripped);
+	assert(forth_run_function(fs, stripped, "main"));
+	assert(forth_data_stack_pop(fs) == 120 * 120);
+	assert(!forth_run_function(fs, stripped, "unused"));
+	assert(!forth_run_function(fs, stripped, "buffer"));
+
+	const char* missing[] = { "nothing" };
+	assert(forth_strip(full, missing, 1) == NULL);
+	printf("\n");
+
+	forth_release_state(fs);
+	forth_release_byte_code(stripped);
+	forth_release_byte_code(full);
+	PASS();
+	return 0;
+}
+
+int main(int argc, char** args) {
+	optimization_levels();
+	hot_reload();
+	lazy_function();
+	lazy_reenter();
+	compile_cache();
+	compile_many();
+	compile_stream();
+	strip_words();
+	return 0;
+}
@@ -1,9 +1,13 @@
 #include "forth_embed.h"
 #include <stdio.h>
 #include <assert.h>
+#include <string.h>
 
 #define PASS() printf("Pass %s\n", __func__);
 
+int bulk_set_level(int level);
+int bulk_get_level();
+
 static const char* fizzbuzz = ""
 ": fizz? 3 mod 0 = dup if .\" Fizz\" then ; "
 ": buzz? 5 mod 0 = dup if .\" Buzz\" then ; "
@@ -14,6 +18,150 @@ static const char* fizzbuzz = ""
 static const char* test_loop = ": loop-test 10 0 do i . loop ; loop-test cr";
 static const char* fibiter = ": fib-iter 0 1 rot 0 do over + swap loop drop ; 3 fib-iter . cr 30 fib-iter .";
 
+static const char* tail_calls = ""
+": count-down dup 0 = invert if 1 - count-down then ; "
+": down dup 0 = if else 1 - recurse then ; "
+": fact dup 1 = invert if dup 1 - recurse * then ; "
+": state-b 1 + ; "
+": state-a 2 * state-b ;";
+
+// uniform loop and words run in lockstep, last if diverge on parity of input
+static const char* batch_script = ""
+"variable calls "
+": step dup 3 * 7 mod + ; "
+": mix 0 10 0 do over i + step + loop swap drop ; "
+": finish dup 2 mod 0 = if 1000 + else 5 0 do 1 + loop then ; "
+"mix dup calls ! count finish";
+
+static void count_native(struct forth_state* fs) {
+	int* counter = forth_get_user_data(fs);
+	(*counter)++;
+}
+
+#define BATCH_STATES 11
+
+int batch_run() {
+	struct forth_byte_code* bc = forth_compile(batch_script);
+
+	int saved_level = bulk_get_level();
+	for (int level = 0; level <= 2; level++) { // scalar, sse2, avx2 lanes
+		bulk_set_level(level);
+		struct forth_state* states[BATCH_STATES];
+		int counters[BATCH_STATES] = { 0 };
+		for (int index = 0; index < BATCH_STATES; index++) {
+			states[index] = forth_make_default_state();
+			forth_set_user_data(states[index], &counters[index]);
+			forth_set_function(states[index], "count", count_native);
+			forth_data_stack_push(states[index], index * 13 - 40);
+		}
+
+		forth_run_batch(states, BATCH_STATES, bc);
+
+		for (int index = 0; index < BATCH_STATES; index++) {
+			int counter = 0;
+			struct forth_state* fs = forth_make_default_state();
+			forth_set_user_data(fs, &counter);
+			forth_set_function(fs, "count", count_native);
+			forth_data_stack_push(fs, index * 13 - 40);
+			forth_run(fs, bc);
+
+			assert(counters[index] == 1 && counter == 1);
+			assert(forth_memory_get(states[index], 0) == forth_memory_get(fs, 0));
+			assert(forth_data_stack_pop(states[index]) == forth_data_stack_pop(fs));
+			forth_release_state(fs);
+			forth_release_state(states[index]);
+		}
+	}
+	bulk_set_level(saved_level);
+
+	struct forth_state* states[2];
+	int counters[2] = { 0 };
+	for (int index = 0; index < 2; index++) {
+		states[index] = forth_make_default_state();
+		forth_set_user_data(states[index], &counters[index]);
+		forth_set_function(states[index], "count", count_native);
+		forth_data_stack_push(states[index], 5);
+	}
+	forth_float_stack_push(states[1], 1.5);
+	forth_run_batch(states, 2, bc); // state with float value is not run
+	printf("\n");
+	assert(forth_get_status(states[0]) == forth_ok && counters[0] == 1);
+	assert(forth_get_status(states[1]) == forth_error && counters[1] == 0 && forth_data_stack_pop(states[1]) == 5);
+	forth_release_state(states[0]);
+	forth_release_state(states[1]);
+
+	forth_release_byte_code(bc);
+	PASS();
+	return 0;
+}
+
+// endless loop while running is true, tick native play watchdog
+static const char* spin_script = ""
+"variable running "
+": spin begin tick running @ until 7 ; "
+"-1 running ! spin";
+
+static void tick_native(struct forth_state* fs) {
+	int* ticks = forth_get_user_data(fs);
+	(*ticks)++;
+	if (*ticks % 1000 == 0) {
+		forth_interrupt(fs);
+	}
+}
+
+int interrupt_resume() {
+	int ticks = 0;
+	struct forth_state* fs = forth_make_default_state();
+	struct forth_byte_code* bc = forth_compile(spin_script);
+	forth_set_user_data(fs, &ticks);
+	forth_set_function(fs, "tick", tick_native);
+
+	assert(forth_run(fs, bc) == forth_interrupted);
+	assert(ticks == 1000);
+	assert(forth_resume(fs, bc) == forth_interrupted);
+	assert(ticks == 2000);
+
+	forth_memory_set(fs, 0, 0); // running false, loop ends after resume
+	assert(forth_resume(fs, bc) == forth_ok);
+	assert(forth_get_status(fs) == forth_ok);
+	assert(ticks == 2000);
+	assert(forth_data_stack_pop(fs) == 7);
+
+	forth_release_state(fs);
+	forth_release_byte_code(bc);
+	PASS();
+	return 0;
+}
+
+// fetch ( key -- value ) is answered by host later
+static void fetch_native(struct forth_state* fs) {
+	int* request = forth_get_user_data(fs);
+	*request = forth_data_stack_pop(fs);
+	forth_suspend(fs);
+}
+
+int async_native() {
+	int request = 0;
+	struct forth_state* fs = forth_make_default_state();
+	struct forth_byte_code* bc = forth_compile(": job fetch 2 * ; 5 job 1 +");
+	forth_set_user_data(fs, &request);
+	forth_set_function(fs, "fetch", fetch_native);
+
+	assert(forth_run(fs, bc) == forth_pending);
+	assert(request == 5);
+	assert(forth_resume(fs, bc) == forth_pending); // not completed yet
+
+	forth_cell result = request * 4;
+	forth_complete_pending(fs, &result, 1);
+	assert(forth_resume(fs, bc) == forth_ok);
+	assert(forth_data_stack_pop(fs) == 41);
+
+	forth_release_state(fs);
+	forth_release_byte_code(bc);
+	PASS();
+	return 0;
+}
+
 int code_tester(const char* code) {
 	struct forth_state* fs = forth_make_default_state();
 	struct forth_byte_code* bc = forth_compile(code);
@@ -27,9 +175,115 @@ int code_tester(const char* code) {
 	return 0;
 }
 
+int tail_call_recursion() {
+	struct forth_state* fs = forth_make_state(50, 100, 16, 10, 10); // tail recursion runs in small return stack
+	struct forth_byte_code* bc = forth_compile(tail_calls);
+	forth_run(fs, bc);
+
+	forth_data_stack_push(fs, 100000);
+	assert(forth_run_function(fs, bc, "count-down"));
+	assert(forth_data_stack_pop(fs) == 0);
+
+	forth_data_stack_push(fs, 100000);
+	assert(forth_run_function(fs, bc, "down"));
+	assert(forth_data_stack_pop(fs) == 0);
+
+	forth_data_stack_push(fs, 10);
+	assert(forth_run_function(fs, bc, "fact"));
+	assert(forth_data_stack_pop(fs) == 3628800);
+
+	forth_data_stack_push(fs, 20);
+	assert(forth_run_function(fs, bc, "state-a"));
+	assert(forth_data_stack_pop(fs) == 41);
+
+	forth_release_state(fs);
+	forth_release_byte_code(bc);
+	PASS();
+	return 0;
+}
+
+#if defined(FORTH_PROFILER)
+static const struct forth_byte_code* profiled_other;
+
+// native run word of other program, samples keep frames of both programs
+static void run_other(struct forth_state* fs) {
+	forth_run_function(fs, profiled_other, "spin");
+}
+
+int profiler() {
+	struct forth_state* fs = forth_make_default_state();
+	struct forth_byte_code* bc = forth_compile(": inner 0 1000 0 do i + loop ; : busy 0 3000 0 do inner + loop ; busy drop");
+	profiled_other = forth_compile(": spin 0 200000 0 do i + loop drop ; spin");
+	struct forth_byte_code* caller = forth_compile(": host other ; host host");
+	forth_run(fs, profiled_other);
+	forth_set_function(fs, "other", run_other);
+	assert(forth_profiler_start(1000));
+	forth_run(fs, bc);
+	forth_run(fs, caller);
+	forth_profiler_stop();
+
+	FILE* output = tmpfile();
+	forth_profiler_dump(output);
+	rewind(output);
+	char line[256];
+	int inner_samples = 0;
+	int other_samples = 0;
+	while (fgets(line, sizeof(line), output) != NULL) {
+		inner_samples += strncmp(line, "top level;busy;inner;", 21) == 0;
+		other_samples += strncmp(line, "top level;host;spin;", 20) == 0;
+	}
+	assert(inner_samples > 0 && other_samples > 0);
+	fclose(output);
+
+	forth_release_state(fs);
+	forth_release_byte_code(bc);
+	forth_release_byte_code(caller);
+	forth_release_byte_code((struct forth_byte_code*)profiled_other);
+	PASS();
+	return 0;
+}
+#endif
+
+#if defined(FORTH_TRACE)
+int trace() {
+	struct forth_state* fs = forth_make_default_state();
+	struct forth_byte_code* bc = forth_compile(": add 1 2 + ; 100 0 do add drop loop 7");
+	forth_run(fs, bc);
+
+	FILE* output = tmpfile();
+	forth_trace_dump(fs, bc, output);
+	rewind(output);
+	char line[256];
+	char last[256] = "";
+	int add_steps = 0;
+	while (fgets(line, sizeof(line), output) != NULL) {
+		add_steps += strstr(line, " add ") != NULL;
+		strcpy(last, line);
+	}
+	assert(add_steps > 0);
+	assert(strstr(last, "top level") != NULL && strstr(last, "literal") != NULL); // 7 is last step
+	fclose(output);
+
+	forth_release_state(fs);
+	forth_release_byte_code(bc);
+	PASS();
+	return 0;
+}
+#endif
+
 int main(int argc, char** args) {
 	code_tester(fizzbuzz);
 	code_tester(test_loop);
 	code_tester(fibiter);
+	tail_call_recursion();
+	batch_run();
+	interrupt_resume();
+	async_native();
+#if defined(FORTH_PROFILER)
+	profiler();
+#endif
+#if defined(FORTH_TRACE)
+	trace();
+#endif
 	return 0;
 }
@@ -0,0 +1,126 @@
+#include "forth_embed.h"
+#include <stdio.h>
+#include <assert.h>
+
+#define PASS() printf("Pass %s\n", __func__);
+
+// testing forth componets
+int bulk_set_level(int level);
+
+static const char* arrays = ""
+"variable a 36 allot "
+"variable b 36 allot "
+"variable c 36 allot "
+": init 37 0 do i a i + ! 37 i - b i + ! loop ; init ";
+
+int run_int(const char* code) {
+	struct forth_state* fs = forth_make_default_state();
+	struct forth_byte_code* bc = forth_compile(code);
+
+	forth_run(fs, bc);
+	int result = forth_data_stack_pop(fs);
+
+	forth_release_state(fs);
+	forth_release_byte_code(bc);
+	return result;
+}
+
+#if defined(FORTH_WORDS_BULK)
+int bulk_words(int level) {
+	char code[512];
+	int selected = bulk_set_level(level);
+
+	snprintf(code, sizeof(code), "%s a 37 sum", arrays);
+	assert(run_int(code) == 666);
+
+	snprintf(code, sizeof(code), "%s a 37 array-max b 37 array-min -", arrays);
+	assert(run_int(code) == 35);
+
+	snprintf(code, sizeof(code), "%s c 37 5 fill c 37 sum", arrays);
+	assert(run_int(code) == 185);
+
+	snprintf(code, sizeof(code), "%s a b c 37 array+ c 37 sum", arrays);
+	assert(run_int(code) == 37 * 37);
+
+	snprintf(code, sizeof(code), "%s a a c 37 array* c 36 + @", arrays);
+	assert(run_int(code) == 36 * 36);
+
+	snprintf(code, sizeof(code), "%s a b c 37 array= c 37 sum", arrays);
+	assert(run_int(code) == 0);
+
+	snprintf(code, sizeof(code), "%s a a c 37 array= c 37 sum", arrays);
+	assert(run_int(code) == -37);
+
+	snprintf(code, sizeof(code), "%s a 37 29 search", arrays);
+	assert(run_int(code) == 29);
+
+	snprintf(code, sizeof(code), "%s a 37 100 search", arrays);
+	assert(run_int(code) == -1);
+
+	snprintf(code, sizeof(code), "%s a c 37 move c 37 sum", arrays);
+	assert(run_int(code) == 666);
+
+	snprintf(code, sizeof(code), "%s a a 1 + 36 cmove a 36 + @", arrays);
+	assert(run_int(code) == 0);
+
+	snprintf(code, sizeof(code), "%s a a 1 + 36 move a 36 + @", arrays);
+	assert(run_int(code) == 35);
+
+	snprintf(code, sizeof(code), "%s a b a 1 + 36 array+ a 36 + @", arrays);
+	assert(run_int(code) == 37 * 36 - 36 * 35 / 2);
+
+	printf("kernel level %d ", selected);
+	PASS();
+	return 0;
+}
+#endif
+
+#if defined(FORTH_WORDS_HEAP)
+int heap_words() {
+	struct forth_state* fs = forth_make_state(50, 1000, 40, 10, 10);
+	struct forth_byte_code* bc = forth_compile(""
+		"variable p variable q "
+		"10 allocate drop p ! 42 p @ ! "
+		"3 allocate drop q ! q @ free q @ free "
+		"3 allocate drop q @ = "
+		"p @ 100 resize drop p ! p @ @ "
+		"2000 allocate swap drop");
+
+	forth_run(fs, bc);
+	assert(forth_data_stack_pop(fs) == -1); // heap meet variables
+	assert(forth_data_stack_pop(fs) == 42); // content moved by resize
+	assert(forth_data_stack_pop(fs) == -1); // freed block reused
+	assert(forth_data_stack_pop(fs) == -1); // second free fails
+	assert(forth_data_stack_pop(fs) == 0);
+
+	struct forth_stats stats;
+	forth_get_stats(fs, &stats);
+	assert(stats.heap_size == 16 + 4 + 128);
+	assert(stats.heap_free == 16); // block of 10 cells freed by resize
+
+	struct forth_byte_code* misuse = forth_compile("1 p @ 1 + ! p @ 2 + free 900 allot variable r");
+	forth_run(fs, misuse); // cell before interior address look like class, allot cross heap
+	printf("\n");
+	assert(forth_data_stack_pop(fs) == -1);
+	forth_get_stats(fs, &stats);
+	assert(stats.memory_used == 3 && stats.heap_free == 16);
+
+	forth_release_byte_code(misuse);
+	forth_release_state(fs);
+	forth_release_byte_code(bc);
+	PASS();
+	return 0;
+}
+#endif
+
+int main(int argc, char** args) {
+#if defined(FORTH_WORDS_BULK)
+	bulk_words(0); // scalar
+	bulk_words(1); // sse2
+	bulk_words(2); // avx2
+#endif
+#if defined(FORTH_WORDS_HEAP)
+	heap_words();
+#endif
+	return 0;
+}
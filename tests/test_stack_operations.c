@@ -235,6 +235,162 @@ int print_string() {
 	return 0;
 }
 
+#if defined(FORTH_WORDS_MESSAGE)
+int message_queue() {
+	struct forth_state* fs = forth_make_default_state();
+	struct forth_byte_code* bc = forth_compile(": drain 0 begin ?message if receive + then ?message until ; drain receive");
+
+	assert(!forth_post_message(fs, 1)); // queue not set
+	assert(forth_set_message_queue(fs, 3));
+	assert(forth_post_message(fs, 10));
+	assert(forth_post_message(fs, 20));
+	assert(forth_post_message(fs, 30));
+	assert(!forth_post_message(fs, 40)); // full
+
+	forth_run(fs, bc);
+	assert(forth_data_stack_pop(fs) == 0); // receive of empty queue
+	assert(forth_data_stack_pop(fs) == 60);
+
+	assert(forth_post_message(fs, 5)); // ring wrap around
+	forth_run(fs, bc);
+	forth_data_stack_pop(fs);
+	assert(forth_data_stack_pop(fs) == 5);
+
+	forth_release_state(fs);
+	forth_release_byte_code(bc);
+	PASS();
+	return 0;
+}
+#endif
+
+int cell_width() {
+	struct forth_state* fs = forth_make_default_state();
+#if FORTH_CELL_BITS == 64
+	struct forth_byte_code* bc = forth_compile("4294967296 3 * 1 -"); // literal and result not fit in 32 bit
+	forth_cell expected = 12884901887LL;
+#else
+	struct forth_byte_code* bc = forth_compile("65536 3 * 1 -");
+	forth_cell expected = 196607;
+#endif
+	assert(sizeof(forth_cell) * 8 == FORTH_CELL_BITS);
+
+	forth_run(fs, bc);
+	assert(forth_data_stack_pop(fs) == expected);
+
+	forth_release_state(fs);
+	forth_release_byte_code(bc);
+	PASS();
+	return 0;
+}
+
+#if defined(FORTH_WORDS_FLOAT)
+int float_words() {
+	struct forth_state* fs = forth_make_default_state();
+	struct forth_byte_code* bc = forth_compile(""
+		"variable speed "
+		": square-sum fdup f* fswap fdup f* f+ ; "
+		"3.0 4e0 square-sum 25.0 f= "
+		"1.5 speed f! speed f@ 7 s>f f* f>s "
+		"0.5 0.25 f< -1.5 f. cr");
+
+	forth_run(fs, bc);
+	assert(forth_data_stack_pop(fs) == 0); // 0.5 < 0.25 false
+	assert(forth_data_stack_pop(fs) == 10); // 10.5 truncated
+	assert(forth_data_stack_pop(fs) == -1);
+
+	forth_float_stack_push(fs, 0.75f);
+	forth_float_stack_push(fs, 2.0f);
+	forth_data_stack_push(fs, 1);
+	struct forth_byte_code* divide = forth_compile("f/ drop");
+	forth_run(fs, divide);
+	assert(forth_float_stack_pop(fs) == 0.375f);
+
+	forth_release_state(fs);
+	forth_release_byte_code(bc);
+	forth_release_byte_code(divide);
+	PASS();
+	return 0;
+}
+#endif
+
+void nothing(struct forth_state* fs) {
+}
+
+int stats() {
+	struct forth_state* fs = forth_make_state(50, 1000, 40, 10, 10);
+	forth_set_function(fs, "nothing", nothing);
+	struct forth_byte_code* bc = forth_compile("variable v 10 allot : deep 1 2 3 4 5 drop drop drop drop drop ; deep nothing nothing 7");
+	forth_run(fs, bc);
+
+	struct forth_stats stats;
+	forth_get_stats(fs, &stats);
+	assert(stats.instructions > 15);
+	assert(stats.native_calls == 2);
+	assert(stats.data_stack_max == 5 && stats.data_stack_size == 50);
+	assert(stats.return_stack_max == 1 && stats.return_stack_size == 40);
+	assert(stats.memory_used == 11 && stats.memory_size == 1000);
+	assert(stats.dictionary_count == 3 && stats.dictionary_size == 10);
+
+	forth_reset_stats(fs);
+	forth_get_stats(fs, &stats);
+	assert(stats.instructions == 0 && stats.native_calls == 0);
+	assert(stats.data_stack_max == 1); // 7 is still on stack
+
+	struct forth_state* lanes[2] = { forth_make_state(50, 1000, 40, 10, 10), forth_make_state(50, 1000, 40, 10, 10) };
+	forth_reset_stats(fs);
+	forth_run(fs, bc);
+	forth_get_stats(fs, &stats);
+	for (int lane = 0; lane < 2; lane++) {
+		forth_set_function(lanes[lane], "nothing", nothing);
+	}
+	forth_run_batch(lanes, 2, bc); // lockstep count same as run of every state
+	for (int lane = 0; lane < 2; lane++) {
+		struct forth_stats lane_stats;
+		forth_get_stats(lanes[lane], &lane_stats);
+		assert(lane_stats.instructions == stats.instructions && lane_stats.native_calls == stats.native_calls);
+		assert(lane_stats.data_stack_max == 5 && lane_stats.return_stack_max == stats.return_stack_max);
+		forth_release_state(lanes[lane]);
+	}
+
+	forth_release_state(fs);
+	forth_release_byte_code(bc);
+	PASS();
+	return 0;
+}
+
+#if defined(FORTH_GUARDED_STACKS)
+int guarded_stacks() {
+	struct forth_state* fs = forth_make_state(16, 100, 8, 10, 10);
+	struct forth_byte_code* forever = forth_compile(": forever recurse 1 ; forever");
+	struct forth_byte_code* flood = forth_compile(": flood begin 1 -1 until ; flood");
+	struct forth_byte_code* sum = forth_compile("1 2 +");
+
+	assert(forth_run(fs, forever) == forth_error); // return stack overflow
+	assert(forth_run(fs, flood) == forth_error); // data stack overflow
+	assert(forth_run(fs, sum) == forth_ok); // state still usable
+	assert(forth_data_stack_pop(fs) == 3);
+
+	struct forth_state* lanes[2] = { fs, forth_make_state(16, 100, 8, 10, 10) };
+	struct forth_byte_code* read = forth_compile("@ drop 7");
+	forth_run_batch(lanes, 2, forever); // shared return stack of lockstep overflow
+	assert(forth_get_status(lanes[0]) == forth_error && forth_get_status(lanes[1]) == forth_error);
+	forth_data_stack_push(lanes[0], 5);
+	forth_data_stack_push(lanes[1], 100); // first cell after memory
+	forth_run_batch(lanes, 2, read);
+	assert(forth_get_status(lanes[0]) == forth_ok && forth_data_stack_pop(lanes[0]) == 7);
+	assert(forth_get_status(lanes[1]) == forth_error);
+
+	forth_release_state(lanes[1]);
+	forth_release_byte_code(read);
+	forth_release_state(fs);
+	forth_release_byte_code(forever);
+	forth_release_byte_code(flood);
+	forth_release_byte_code(sum);
+	PASS();
+	return 0;
+}
+#endif
+
 int main(int argc, char** args) {
 	push_pop();
 	drop();
@@ -246,5 +402,16 @@ int main(int argc, char** args) {
 	emit();
 	cr();
 	print_string();
+#if defined(FORTH_WORDS_MESSAGE)
+	message_queue();
+#endif
+	cell_width();
+#if defined(FORTH_WORDS_FLOAT)
+	float_words();
+#endif
+	stats();
+#if defined(FORTH_GUARDED_STACKS)
+	guarded_stacks();
+#endif
 	return 0;
 }
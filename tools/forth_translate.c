@@ -0,0 +1,404 @@
+// Ahead of time translator: forth script to C source.
+// Every : word become native function on struct forth_state registered by forth_set_function,
+// top level code of script is compiled and run by interpreter.
+// usage: forth_translate <script.fs> <output.c> <output.h> <prefix>
+
+#include "forth_embed.c" // reuse tokenizer and token types
+#include <stdarg.h>
+#include <math.h>
+
+struct translator {
+	struct forth_byte_code* program;
+	FILE* out;
+	const char* prefix;
+
+	int* words; // positions of : tokens
+	int word_count;
+
+	char** ops; // source of words run by interpreter from native code
+	int op_count;
+
+	int depth; // indent and do loop index name
+	int loop_depth;
+	int current_word;
+	bool failed;
+};
+
+static char* read_file(const char* path) {
+	FILE* file = fopen(path, "rb");
+	if (file == NULL) {
+		return NULL;
+	}
+	fseek(file, 0, SEEK_END);
+	long size = ftell(file);
+	fseek(file, 0, SEEK_SET);
+
+	char* source = malloc(size + 1);
+	size_t read = fread(source, 1, size, file);
+	source[read] = '\0';
+	fclose(file);
+	return source;
+}
+
+// float literal of C or forth source, inf and nan have no literal in both
+static void float_source(double value, bool c_source, char* buffer, size_t size) {
+	if (isnan(value)) {
+		snprintf(buffer, size, "%s", c_source ? "NAN" : "0e0 0e0 f/");
+	} else if (isinf(value)) {
+		snprintf(buffer, size, "%s", c_source ? (value < 0 ? "-INFINITY" : "INFINITY") : (value < 0 ? "-1e999" : "1e999"));
+	} else {
+		snprintf(buffer, size, "%.17g", value);
+		if (not strpbrk(buffer, ".eE")) // keep float literal
+			strncat(buffer, ".0", size - strlen(buffer) - 1);
+	}
+}
+
+// source word of token, used for interpreter fallback and top level code
+static void token_source(const struct token current_token, char* buffer, size_t size) {
+	switch (current_token.type) {
+	case tt_value:
+		snprintf(buffer, size, "%lld", (long long)current_token.data.integer);
+		break;
+	case tt_float_value:
+		float_source((double)current_token.data.real, false, buffer, size);
+		break;
+	case tt_ident:
+	case tt_tail_call:
+		snprintf(buffer, size, "%s", current_token.data.name);
+		break;
+	case tt_dotstring:
+		snprintf(buffer, size, ".\"%s\"", current_token.data.string);
+		break;
+	case tt_tail_recurse:
+		snprintf(buffer, size, "recurse");
+		break;
+	default:
+		snprintf(buffer, size, "%s", token_names[current_token.type]);
+		break;
+	}
+}
+
+static void write_c_string(FILE* out, const char* string) {
+	fputc('"', out);
+	for (const char* c = string; *c; c++) {
+		switch (*c) {
+		case '"': fputs("\\\"", out); break;
+		case '\\': fputs("\\\\", out); break;
+		case '\n': fputs("\\n", out); break;
+		case '\t': fputs("\\t", out); break;
+		case '\r': fputs("\\r", out); break;
+		default:
+			if (isprint((unsigned char)*c))
+				fputc(*c, out);
+			else
+				fprintf(out, "\\%03o", (unsigned char)*c);
+		}
+	}
+	fputc('"', out);
+}
+
+static int find_word(const struct translator* tr, const char* name) { // last definition win like in dictionary
+	for (int i = tr->word_count - 1; i >= 0; i--) {
+		if (strcmp(tr->program->stream[tr->words[i] + 1].data.name, name) == 0)
+			return i;
+	}
+	return -1;
+}
+
+static int find_op(struct translator* tr, const char* source) {
+	for (int i = 0; i < tr->op_count; i++) {
+		if (strcmp(tr->ops[i], source) == 0)
+			return i;
+	}
+	tr->ops[tr->op_count] = strdup(source);
+	return tr->op_count++;
+}
+
+static void line(struct translator* tr, const char* format, ...) {
+	if (tr->out == NULL) { // first pass collect interpreter ops only
+		return;
+	}
+	for (int i = 0; i < tr->depth; i++)
+		fputc('\t', tr->out);
+	va_list args;
+	va_start(args, format);
+	vfprintf(tr->out, format, args);
+	va_end(args);
+	fputc('\n', tr->out);
+}
+
+static void interpreter_op(struct translator* tr, const char* source) {
+	line(tr, "forth_run(fs, %s_ops[%d]); // %s", tr->prefix, find_op(tr, source), source);
+}
+
+// translate body token, return position of last used token
+static int translate_token(struct translator* tr, int position) {
+	const struct token current_token = tr->program->stream[position];
+	char source[256];
+
+	switch (current_token.type) {
+	case tt_value: line(tr, "push(%lld);", (long long)current_token.data.integer); break;
+	case tt_dup: line(tr, "{ forth_cell a = pop(); push(a); push(a); }"); break;
+	case tt_drop: line(tr, "pop();"); break;
+	case tt_swap: line(tr, "{ forth_cell a = pop(); forth_cell b = pop(); push(a); push(b); }"); break;
+	case tt_over: line(tr, "{ forth_cell a = pop(); forth_cell b = pop(); push(b); push(a); push(b); }"); break;
+	case tt_rot: line(tr, "{ forth_cell a = pop(); forth_cell b = pop(); forth_cell c = pop(); push(b); push(a); push(c); }"); break;
+	case tt_dot: line(tr, "printf(\"%%lld \", (long long)pop());"); break;
+	case tt_cr: line(tr, "printf(\"\\n\");"); break;
+
+	case tt_equal: line(tr, "{ forth_cell a = pop(); forth_cell b = pop(); push(b == a ? -1 : 0); }"); break;
+	case tt_great: line(tr, "{ forth_cell a = pop(); forth_cell b = pop(); push(b > a ? -1 : 0); }"); break;
+	case tt_less: line(tr, "{ forth_cell a = pop(); forth_cell b = pop(); push(b < a ? -1 : 0); }"); break;
+	case tt_invert: line(tr, "push(~pop());"); break;
+	case tt_and: line(tr, "{ forth_cell a = pop(); forth_cell b = pop(); push(a == -1 && b == -1 ? -1 : 0); }"); break;
+	case tt_or: line(tr, "{ forth_cell a = pop(); forth_cell b = pop(); push(a == -1 || b == -1 ? -1 : 0); }"); break;
+
+	case tt_plus: line(tr, "{ forth_cell a = pop(); forth_cell b = pop(); push(b + a); }"); break;
+	case tt_minus: line(tr, "{ forth_cell a = pop(); forth_cell b = pop(); push(b - a); }"); break;
+	case tt_multip: line(tr, "{ forth_cell a = pop(); forth_cell b = pop(); push(b * a); }"); break;
+	case tt_div: line(tr, "{ forth_cell a = pop(); forth_cell b = pop(); push(b / a); }"); break;
+	case tt_mod: line(tr, "{ forth_cell a = pop(); forth_cell b = pop(); push(b %% a); }"); break;
+
+	case tt_float_value:
+		float_source((double)current_token.data.real, true, source, sizeof(source));
+		line(tr, "fpush((forth_float)%s);", source);
+		break;
+#if defined(FORTH_WORDS_FLOAT)
+	case tt_fplus: line(tr, "{ forth_float a = fpop(); forth_float b = fpop(); fpush(b + a); }"); break;
+	case tt_fminus: line(tr, "{ forth_float a = fpop(); forth_float b = fpop(); fpush(b - a); }"); break;
+	case tt_fmultip: line(tr, "{ forth_float a = fpop(); forth_float b = fpop(); fpush(b * a); }"); break;
+	case tt_fdiv: line(tr, "{ forth_float a = fpop(); forth_float b = fpop(); fpush(b / a); }"); break;
+	case tt_fless: line(tr, "{ forth_float a = fpop(); forth_float b = fpop(); push(b < a ? -1 : 0); }"); break;
+	case tt_fequal: line(tr, "{ forth_float a = fpop(); forth_float b = fpop(); push(b == a ? -1 : 0); }"); break;
+	case tt_fdup: line(tr, "{ forth_float a = fpop(); fpush(a); fpush(a); }"); break;
+	case tt_fdrop: line(tr, "fpop();"); break;
+	case tt_fswap: line(tr, "{ forth_float a = fpop(); forth_float b = fpop(); fpush(a); fpush(b); }"); break;
+	case tt_int_to_float: line(tr, "fpush((forth_float)pop());"); break;
+	case tt_float_to_int: line(tr, "push((forth_cell)fpop());"); break;
+#endif
+
+	case tt_at: line(tr, "push(forth_memory_get(fs, (int)pop()));"); break;
+	case tt_setvalue: line(tr, "{ forth_cell address = pop(); forth_memory_set(fs, (int)address, pop()); }"); break;
+	case tt_cells: break;
+
+	case tt_dotstring:
+		if (tr->out) {
+			for (int i = 0; i < tr->depth; i++)
+				fputc('\t', tr->out);
+			fputs("printf(\"%s\", ", tr->out);
+			write_c_string(tr->out, current_token.data.string);
+			fputs(");\n", tr->out);
+		}
+		break;
+
+	case tt_if:
+		line(tr, "if (pop() == -1) {");
+		tr->depth++;
+		break;
+
+	case tt_else:
+		tr->depth--;
+		line(tr, "} else {");
+		tr->depth++;
+		break;
+
+	case tt_then:
+		tr->depth--;
+		line(tr, "}");
+		break;
+
+	case tt_do:
+		line(tr, "{ forth_cell start%d = pop(); forth_cell end%d = pop();", tr->loop_depth, tr->loop_depth);
+		tr->depth++;
+		line(tr, "for (forth_cell index%d = start%d; index%d < end%d; index%d++) {", tr->loop_depth, tr->loop_depth, tr->loop_depth, tr->loop_depth, tr->loop_depth);
+		tr->depth++;
+		tr->loop_depth++;
+		break;
+
+	case tt_loop:
+		tr->loop_depth--;
+		tr->depth--;
+		line(tr, "}");
+		tr->depth--;
+		line(tr, "}");
+		break;
+
+	case tt_index:
+		if (tr->loop_depth == 0) {
+			fprintf(stderr, "Error i used outside of do loop in word: %s\n", tr->program->stream[tr->words[tr->current_word] + 1].data.name);
+			tr->failed = true;
+		}
+		line(tr, "push(index%d);", tr->loop_depth - 1);
+		break;
+
+	case tt_begin:
+		line(tr, "do {");
+		tr->depth++;
+		break;
+
+	case tt_until: // jump back to begin while flag is true
+		tr->depth--;
+		line(tr, "} while (pop() == -1);");
+		break;
+
+	case tt_recurse:
+	case tt_tail_recurse:
+		line(tr, "%s_word_%d(fs);", tr->prefix, tr->current_word);
+		break;
+
+	case tt_ident:
+	case tt_tail_call: {
+		int word = find_word(tr, current_token.data.name);
+		if (word >= 0) {
+			line(tr, "%s_word_%d(fs); // %s", tr->prefix, word, current_token.data.name);
+		} else { // native, constant or variable found by name
+			interpreter_op(tr, current_token.data.name);
+		}
+		break;
+	}
+
+	case tt_constant:
+	case tt_variable: // define name in dictionary, name is next token
+		snprintf(source, sizeof(source), "%s %s", token_names[current_token.type], tr->program->stream[position + 1].data.name);
+		interpreter_op(tr, source);
+		return position + 1;
+
+	default: // other words have same behavior as in interpreter
+		token_source(current_token, source, sizeof(source));
+		interpreter_op(tr, source);
+		break;
+	}
+	return position;
+}
+
+static void translate_word(struct translator* tr, int word) {
+	int position = tr->words[word];
+	tr->current_word = word;
+	tr->depth = 1;
+	tr->loop_depth = 0;
+
+	if (tr->out)
+		fprintf(tr->out, "static void %s_word_%d(struct forth_state* fs) { // %s\n", tr->prefix, word, tr->program->stream[position + 1].data.name);
+	for (position += 2; position < tr->program->count and tr->program->stream[position].type != tt_semicolon; position++) {
+		position = translate_token(tr, position);
+	}
+	if (tr->out)
+		fprintf(tr->out, "}\n\n");
+}
+
+static bool write_source(struct translator* tr, const char* script_path) {
+	FILE* out = tr->out;
+	fprintf(out, "// Generated by forth_translate from %s, do not edit\n", script_path);
+	fprintf(out, "#include \"forth_embed.h\"\n#include <stdio.h>\n#include <math.h>\n\n");
+	fprintf(out, "#define pop() forth_data_stack_pop(fs)\n#define push(value) forth_data_stack_push(fs, (value))\n");
+	fprintf(out, "#define fpop() forth_float_stack_pop(fs)\n#define fpush(value) forth_float_stack_push(fs, (value))\n\n");
+	fprintf(out, "static const struct forth_byte_code* %s_ops[%d];\n", tr->prefix, tr->op_count > 0 ? tr->op_count : 1);
+	fprintf(out, "static const struct forth_byte_code* %s_program;\n\n", tr->prefix);
+
+	for (int word = 0; word < tr->word_count; word++)
+		fprintf(out, "static void %s_word_%d(struct forth_state* fs);\n", tr->prefix, word);
+	fprintf(out, "\n");
+
+	for (int word = 0; word < tr->word_count; word++)
+		translate_word(tr, word);
+
+	// programs are compiled once by init, register and run only read them and can be called from any thread
+	fprintf(out, "void %s_init(void) {\n", tr->prefix);
+	for (int i = 0; i < tr->op_count; i++) {
+		fprintf(out, "\t%s_ops[%d] = forth_compile(", tr->prefix, i);
+		write_c_string(out, tr->ops[i]);
+		fprintf(out, ");\n");
+	}
+	fprintf(out, "\t%s_program = forth_compile(\"\"", tr->prefix); // top level code without : words
+	bool in_word = false;
+	for (int position = 0; position < tr->program->count; position++) {
+		const struct token current_token = tr->program->stream[position];
+		if (current_token.type == tt_function)
+			in_word = true;
+		if (not in_word) {
+			char source[256];
+			token_source(current_token, source, sizeof(source));
+			fprintf(out, "\n\t\t");
+			write_c_string(out, source);
+			fprintf(out, " \" \"");
+		}
+		if (current_token.type == tt_semicolon)
+			in_word = false;
+	}
+	fprintf(out, ");\n}\n\n");
+
+	fprintf(out, "void %s_register(struct forth_state* fs) {\n", tr->prefix);
+	for (int word = 0; word < tr->word_count; word++) {
+		fprintf(out, "\tforth_set_function(fs, ");
+		write_c_string(out, tr->program->stream[tr->words[word] + 1].data.name);
+		fprintf(out, ", %s_word_%d);\n", tr->prefix, word);
+	}
+	fprintf(out, "}\n\n");
+
+	fprintf(out, "void %s_run(struct forth_state* fs) {\n\tforth_run(fs, %s_program);\n}\n", tr->prefix, tr->prefix);
+	return not tr->failed;
+}
+
+static bool write_header(const struct translator* tr, const char* header_path, const char* script_path) {
+	FILE* out = fopen(header_path, "w");
+	if (out == NULL) {
+		return false;
+	}
+	fprintf(out, "// Generated by forth_translate from %s, do not edit\n#pragma once\n\nstruct forth_state;\n\n", script_path);
+	fprintf(out, "// compile interpreter parts of script, call once before register and run (not thread safe)\nvoid %s_init(void);\n", tr->prefix);
+	fprintf(out, "// register words of script as native functions\nvoid %s_register(struct forth_state* fs);\n", tr->prefix);
+	fprintf(out, "// run top level code of script (constants, variables, calls)\nvoid %s_run(struct forth_state* fs);\n", tr->prefix);
+	fclose(out);
+	return true;
+}
+
+int main(int argc, char** args) {
+	if (argc != 5) {
+		fprintf(stderr, "usage: forth_translate <script.fs> <output.c> <output.h> <prefix>\n");
+		return 1;
+	}
+
+	char* source = read_file(args[1]);
+	if (source == NULL) {
+		fprintf(stderr, "Error can not read script: %s\n", args[1]);
+		return 1;
+	}
+
+	struct translator tr = { .prefix = args[4] };
+	tr.program = compile(source, 0, false);
+	free(source);
+	if (tr.program == NULL) {
+		fprintf(stderr, "Error can not compile script: %s\n", args[1]);
+		return 1;
+	}
+
+	tr.words = calloc(tr.program->count + 1, sizeof(int));
+	tr.ops = calloc(tr.program->count + 1, sizeof(char*));
+	for (int position = 0; position < tr.program->count; position++) {
+		if (tr.program->stream[position].type == tt_function)
+			tr.words[tr.word_count++] = position;
+	}
+
+	for (int word = 0; word < tr.word_count; word++) // collect interpreter ops before output
+		translate_word(&tr, word);
+
+	tr.out = fopen(args[2], "w");
+	if (tr.out == NULL or tr.failed) {
+		fprintf(stderr, "Error can not translate script: %s\n", args[1]);
+		return 1;
+	}
+	bool written = write_source(&tr, args[1]);
+	fclose(tr.out);
+
+	if (not written or not write_header(&tr, args[3], args[1])) {
+		remove(args[2]);
+		return 1;
+	}
+
+	for (int i = 0; i < tr.op_count; i++)
+		free(tr.ops[i]);
+	free(tr.ops);
+	free(tr.words);
+	forth_release_byte_code(tr.program);
+	return 0;
+}
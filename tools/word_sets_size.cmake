@@ -0,0 +1,56 @@
+# Size of library object and count of key words with all word sets and with core words only.
+# usage: cmake [-DWORK_DIR=<dir>] -P tools/word_sets_size.cmake (release builds, binutils size)
+cmake_minimum_required(VERSION 3.14)
+
+get_filename_component(source_dir ${CMAKE_CURRENT_LIST_DIR} DIRECTORY)
+if(NOT WORK_DIR)
+    set(WORK_DIR ${CMAKE_CURRENT_BINARY_DIR}/word_sets_size)
+endif()
+find_program(SIZE_COMMAND size)
+if(NOT SIZE_COMMAND)
+    message(FATAL_ERROR "size of binutils is not found")
+endif()
+
+# key words of set are TOKENS entries of its FOREACH_<SET>_TOKENS list
+file(READ ${source_dir}/forth_embed.c source)
+function(count_key_words word_set result)
+    string(TOUPPER ${word_set} word_set_upper)
+    string(REGEX MATCH "#define FOREACH_${word_set_upper}_TOKENS\\(TOKENS\\) \\\\\n[^#]*" block "${source}")
+    string(REGEX MATCHALL "TOKENS\\(tt_" words "${block}")
+    list(LENGTH words count)
+    set(${result} ${count} PARENT_SCOPE)
+endfunction()
+
+foreach(config all core)
+    set(build_dir ${WORK_DIR}/${config})
+    set(word_sets bulk float heap message) # default of FORTH_WORD_SETS
+    set(options)
+    if(config STREQUAL core)
+        set(word_sets)
+        set(options -DFORTH_WORD_SETS=)
+    endif()
+
+    execute_process(COMMAND ${CMAKE_COMMAND} -S ${source_dir} -B ${build_dir} -DCMAKE_BUILD_TYPE=Release
+        -DBUILD_TESTING=OFF -DFORTH_BUILD_TRANSLATOR=OFF ${options}
+        OUTPUT_QUIET RESULT_VARIABLE failed)
+    if(NOT failed)
+        execute_process(COMMAND ${CMAKE_COMMAND} --build ${build_dir} --target Forth-embed OUTPUT_QUIET RESULT_VARIABLE failed)
+    endif()
+    if(failed)
+        message(FATAL_ERROR "build of ${config} word sets failed")
+    endif()
+
+    file(GLOB_RECURSE object ${build_dir}/CMakeFiles/Forth-embed.dir/*forth_embed.c.o ${build_dir}/CMakeFiles/Forth-embed.dir/*forth_embed.c.obj)
+    execute_process(COMMAND ${SIZE_COMMAND} ${object} OUTPUT_VARIABLE size_output)
+    string(REGEX MATCH "\n *([0-9]+)[ \t]+([0-9]+)[ \t]+([0-9]+)" size_line "${size_output}")
+    set(text ${CMAKE_MATCH_1})
+    set(data ${CMAKE_MATCH_2})
+    set(bss ${CMAKE_MATCH_3})
+
+    count_key_words(core key_words)
+    foreach(word_set ${word_sets})
+        count_key_words(${word_set} set_key_words)
+        math(EXPR key_words "${key_words} + ${set_key_words}")
+    endforeach()
+    message("${config}: text ${text} data ${data} bss ${bss} bytes, ${key_words} key words")
+endforeach()